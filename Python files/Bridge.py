@@ -11,16 +11,26 @@ Features:
 
 Install:
   pip install websockets livekit livekit-api numpy
+  pip install opuslib   # optional, enables Opus uplink and downlink
 """
 
 import asyncio
 import websockets
 import json
+import random
+import struct
+import time
 import numpy as np
 from livekit import rtc, api
 from datetime import datetime
 import logging
 
+try:
+    import opuslib
+    OPUS_AVAILABLE = True
+except ImportError:
+    OPUS_AVAILABLE = False
+
 logging.basicConfig(
     level=logging.INFO,
     format='%(asctime)s - %(levelname)s - %(message)s'
@@ -40,6 +50,375 @@ WS_PORT = 8765
 SAMPLE_RATE = 16000
 CHANNELS = 1
 
+# Preferred uplink codecs, best first; raw PCM is always the fallback
+UPLINK_CODECS = ['opus', 'pcm16'] if OPUS_AVAILABLE else ['pcm16']
+# Everything the bridge can decode (a device may pick any of these per session)
+SUPPORTED_CODECS = ['pcm16', 'adpcm'] + (['opus'] if OPUS_AVAILABLE else [])
+OPUS_MAX_FRAME_SAMPLES = SAMPLE_RATE * 60 // 1000
+
+# Rate TTS is pulled from LiveKit at and declared to the device, which
+# resamples PCM / ADPCM itself (16000 makes LiveKit do it instead)
+DOWNLINK_SAMPLE_RATE = 48000
+
+# Downlink Opus: TTS is encoded at its native rate, the device decodes at 16 kHz
+DOWNLINK_OPUS_FRAME_MS = 20
+DOWNLINK_OPUS_BITRATE = 24000
+
+# Uplink batching: capture frames coalesced per WebSocket message (30/60/90 ms).
+# Raise it when many devices share one AP; fewer, larger packets per device.
+UPLINK_BATCH_MS = 30
+
+# Downlink messages larger than this go out as WebSocket fragments, which the
+# device parses as they arrive instead of allocating the whole message.
+# 10 ms of 48 kHz PCM is a 972-byte message: two fragments
+DOWNLINK_FRAGMENT_BYTES = 512
+
+# Accept the compact binary control encoding when a device offers it;
+# JSON text is used otherwise (and always for device_info / ready)
+CONTROL_BINARY = True
+
+# Audio over RTP/UDP when the device offers it in device_info, so a lost
+# TCP segment no longer stalls every frame behind it; control stays on the
+# WebSocket. Downlink datagrams carry at most RTP_MAX_SAMPLES each.
+# Lost datagrams become zeros (up to LOST_FILL_MS per gap); VAD silence
+# comes in-band as AUDIO_FLAG_SILENCE records, in order with the audio.
+RTP_ENABLED = True
+RTP_PORT = 5004
+RTP_MAX_SAMPLES = 480  # 10 ms at 48 kHz, 960 bytes of PCM: well under the MTU
+LOST_FILL_MS = 500  # longest uplink gap replaced with silence; beyond it the device restarted
+
+# ==================== CODECS ====================
+
+def split_opus_packets(data: bytes):
+    """Split a device Opus message into packets ([u16 LE length][payload]...)"""
+    offset = 0
+    while offset + 2 <= len(data):
+        length = int.from_bytes(data[offset:offset + 2], 'little')
+        offset += 2
+        if offset + length > len(data):
+            logger.warning("⚠️ Truncated Opus packet")
+            break
+        yield data[offset:offset + length]
+        offset += length
+
+def choose_downlink_codec(uplink_codec: str, device_codecs) -> str:
+    """Opus when both ends have it, else mirror an ADPCM uplink, else raw PCM"""
+    if OPUS_AVAILABLE and 'opus' in device_codecs:
+        return 'opus'
+    if uplink_codec == 'adpcm' and 'adpcm' in device_codecs:
+        return 'adpcm'
+    return 'pcm16'
+
+class OpusDownlinkEncoder:
+    """Re-chunks TTS frames into Opus packets ([u16 LE length][payload]...)"""
+    
+    def __init__(self):
+        self.encoder = None
+        self.frame_samples = 0
+        self.pending = np.zeros(0, dtype=np.int16)
+    
+    def encode(self, samples: np.ndarray, sample_rate: int) -> bytes:
+        if self.encoder is None:
+            self.encoder = opuslib.Encoder(sample_rate, CHANNELS, opuslib.APPLICATION_VOIP)
+            self.encoder.bitrate = DOWNLINK_OPUS_BITRATE
+            self.frame_samples = sample_rate * DOWNLINK_OPUS_FRAME_MS // 1000
+        
+        self.pending = np.concatenate((self.pending, samples))
+        payload = b''
+        while len(self.pending) >= self.frame_samples:
+            frame, self.pending = self.pending[:self.frame_samples], self.pending[self.frame_samples:]
+            packet = self.encoder.encode(frame.tobytes(), self.frame_samples)
+            payload += len(packet).to_bytes(2, 'little') + packet
+        return payload
+
+# ==================== AUDIO FRAMING ====================
+
+# Matches include/audio_frame_header.h: version, codec, flags, reserved,
+# sequence, payload length, sender timestamp (us, wraps at 32 bits)
+AUDIO_HEADER = struct.Struct('<BBBBHHI')
+AUDIO_HEADER_VERSION = 0xA1
+AUDIO_FLAG_MARKER = 0x01
+AUDIO_FLAG_PREROLL = 0x02
+AUDIO_FLAG_SILENCE = 0x04  # payload: u32 samples the device's VAD skipped
+
+CODEC_IDS = {'pcm16': 0, 'opus': 1, 'adpcm': 2}
+CODEC_NAMES = {v: k for k, v in CODEC_IDS.items()}
+
+def now_us() -> int:
+    return int(time.monotonic() * 1_000_000) & 0xFFFFFFFF
+
+def pack_audio_frame(codec: str, flags: int, sequence: int, timestamp_us: int, payload: bytes) -> bytes:
+    header = AUDIO_HEADER.pack(AUDIO_HEADER_VERSION, CODEC_IDS[codec], flags, 0,
+                               sequence & 0xFFFF, len(payload), timestamp_us & 0xFFFFFFFF)
+    return header + payload
+
+def unpack_audio_frames(data: bytes):
+    """Yield (codec, flags, sequence, timestamp_us, payload) per record"""
+    offset = 0
+    while offset + AUDIO_HEADER.size <= len(data):
+        version, codec, flags, _, sequence, length, timestamp_us = \
+            AUDIO_HEADER.unpack_from(data, offset)
+        offset += AUDIO_HEADER.size
+        if version != AUDIO_HEADER_VERSION or offset + length > len(data):
+            logger.warning("⚠️ Malformed audio frame")
+            return
+        yield CODEC_NAMES.get(codec, 'pcm16'), flags, sequence, timestamp_us, data[offset:offset + length]
+        offset += length
+
+# ==================== CONTROL MESSAGES ====================
+
+# Matches include/control_message.h: [0xC1][type][u8 tag][u8 len][value]...
+# Integers little-endian in 1/2/4 bytes, strings raw UTF-8, codec lists a
+# bit mask of codec ids. Unknown tags are skipped.
+CONTROL_MAGIC = 0xC1
+
+CONTROL_TYPES = [
+    'unknown', 'device_info', 'ready', 'start_session', 'session_started',
+    'end_session', 'session_ended', 'silence', 'uplink_batching', 'vad_config',
+    'vad_speech_start', 'vad_speech_end', 'transcript', 'agent_speaking_start',
+    'agent_speaking_end'
+]
+CONTROL_TYPE_IDS = {name: i for i, name in enumerate(CONTROL_TYPES)}
+
+# JSON key -> (tag, kind); kinds: str, uint, bool, codec, codecs, q8 (8.8 fixed point)
+CONTROL_FIELDS = {
+    'session_id': (1, 'str'),
+    'device_id': (2, 'str'),
+    'control': (3, 'str'),
+    'text': (4, 'str'),
+    'codec': (5, 'codec'),
+    'codecs': (6, 'codecs'),
+    'downlink_codec': (7, 'codec'),
+    'downlink_codecs': (8, 'codecs'),
+    'sample_rate': (9, 'uint'),
+    'channels': (10, 'uint'),
+    'opus_frame_ms': (11, 'uint'),
+    'opus_bitrate': (12, 'uint'),
+    'uplink_batch_ms': (13, 'uint'),
+    'latency_ms': (14, 'uint'),
+    'samples': (15, 'uint'),
+    'enabled': (16, 'bool'),
+    'hangover_frames': (17, 'uint'),
+    'energy_margin': (18, 'q8'),
+    'min_energy': (19, 'uint'),
+    'is_final': (20, 'bool'),
+    'frames_captured': (21, 'uint'),
+    'frames_dropped': (22, 'uint'),
+    'frames_suppressed': (23, 'uint'),
+    'frames_sent': (24, 'uint'),
+    'rtp_port': (25, 'uint'),
+    'ssrc': (26, 'uint'),
+}
+CONTROL_TAGS = {tag: (key, kind) for key, (tag, kind) in CONTROL_FIELDS.items()}
+
+def encode_control(msg: dict) -> bytes:
+    """Binary form of a control message; keys without a tag are dropped"""
+    out = bytearray((CONTROL_MAGIC, CONTROL_TYPE_IDS.get(msg.get('type'), 0)))
+    for key, value in msg.items():
+        if key not in CONTROL_FIELDS:
+            continue
+        tag, kind = CONTROL_FIELDS[key]
+        if kind == 'str':
+            data = str(value).encode()[:255]
+        else:
+            if kind == 'codec':
+                value = CODEC_IDS.get(value, 0)
+            elif kind == 'codecs':
+                value = sum(1 << CODEC_IDS[c] for c in set(value) if c in CODEC_IDS)
+            elif kind == 'q8':
+                value = round(value * 256)
+            value = max(0, int(value))
+            data = value.to_bytes(4 if value > 0xFFFF else 2 if value > 0xFF else 1, 'little')
+        out += bytes((tag, len(data))) + data
+    return bytes(out)
+
+def decode_control(data: bytes) -> dict:
+    """Inverse of encode_control; None if the message is truncated"""
+    if len(data) < 2 or data[0] != CONTROL_MAGIC:
+        return None
+    msg = {'type': CONTROL_TYPES[data[1]] if data[1] < len(CONTROL_TYPES) else 'unknown'}
+    offset = 2
+    while offset + 2 <= len(data):
+        tag, length = data[offset], data[offset + 1]
+        offset += 2
+        if offset + length > len(data):
+            return None
+        value = data[offset:offset + length]
+        offset += length
+        if tag not in CONTROL_TAGS:
+            continue
+        key, kind = CONTROL_TAGS[tag]
+        if kind == 'str':
+            msg[key] = value.decode(errors='replace')
+            continue
+        number = int.from_bytes(value, 'little')
+        if kind == 'bool':
+            msg[key] = bool(number)
+        elif kind == 'codec':
+            msg[key] = CODEC_NAMES.get(number, 'pcm16')
+        elif kind == 'codecs':
+            msg[key] = [name for codec, name in CODEC_NAMES.items() if number & (1 << codec)]
+        elif kind == 'q8':
+            msg[key] = number / 256
+        else:
+            msg[key] = number
+    return msg
+
+# Matches include/rtp_header.h: RFC 3550 fixed header (big-endian), 1 MHz
+# clock, then one ordinary audio message
+RTP_HEADER = struct.Struct('>BBHII')
+RTP_VERSION_BYTE = 0x80
+RTP_PAYLOAD_TYPE = 96
+RTP_MARKER = 0x80
+
+def pack_rtp(marker: bool, sequence: int, timestamp_us: int, ssrc: int, message: bytes) -> bytes:
+    return RTP_HEADER.pack(RTP_VERSION_BYTE, (RTP_MARKER if marker else 0) | RTP_PAYLOAD_TYPE,
+                           sequence & 0xFFFF, timestamp_us & 0xFFFFFFFF, ssrc) + message
+
+def unpack_rtp(data: bytes):
+    """(marker, sequence, timestamp_us, ssrc, message), or None if not ours"""
+    if len(data) < RTP_HEADER.size:
+        return None
+    version, mpt, sequence, timestamp_us, ssrc = RTP_HEADER.unpack_from(data)
+    if version != RTP_VERSION_BYTE or (mpt & ~RTP_MARKER) != RTP_PAYLOAD_TYPE:
+        return None
+    return bool(mpt & RTP_MARKER), sequence, timestamp_us, ssrc, data[RTP_HEADER.size:]
+
+class RtpEndpoint(asyncio.DatagramProtocol):
+    """The bridge's UDP socket: uplink demuxed by device SSRC, downlink sent"""
+    
+    def __init__(self):
+        self.transport = None
+        self.sessions = {}  # device SSRC -> DeviceSession
+        self.stray = 0
+    
+    def connection_made(self, transport):
+        self.transport = transport
+    
+    def datagram_received(self, data: bytes, addr):
+        packet = unpack_rtp(data)
+        session = self.sessions.get(packet[3]) if packet else None
+        if session is None:
+            self.stray += 1
+            return
+        session.rtp_uplink.put_nowait(packet[4])
+    
+    def send(self, session, message: bytes, marker: bool):
+        self.transport.sendto(pack_rtp(marker, session.rtp_sequence, now_us(),
+                                       session.downlink_ssrc, message), session.rtp_addr)
+        session.rtp_sequence = (session.rtp_sequence + 1) & 0xFFFF
+
+class StreamStats:
+    """Loss, reordering and interarrival jitter for one audio direction"""
+    
+    def __init__(self):
+        self.expected = None
+        self.lost = 0
+        self.late = 0
+        self.jitter_us = 0.0
+        self.last_transit = None
+    
+    def track(self, sequence: int, timestamp_us) -> int:
+        """Frames missing just before this one; -1 if it is older than one already seen.
+        timestamp_us None (silence records) counts the frame without a jitter sample."""
+        delta = 0
+        if self.expected is not None:
+            delta = ((sequence - self.expected + 0x8000) & 0xFFFF) - 0x8000
+            if delta < 0:
+                self.late += 1
+                return -1
+            self.lost += delta
+        self.expected = (sequence + 1) & 0xFFFF
+        
+        if timestamp_us is None:
+            return delta
+        
+        # Sender and receiver clocks differ; only changes in transit time matter
+        transit = (now_us() - timestamp_us) & 0xFFFFFFFF
+        if self.last_transit is not None:
+            d = ((transit - self.last_transit + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+            self.jitter_us += (abs(d) - self.jitter_us) / 16
+        self.last_transit = transit
+        return delta
+    
+    def summary(self) -> str:
+        return f"{self.lost} lost, {self.late} late, jitter {self.jitter_us / 1000:.1f} ms"
+
+# IMA-ADPCM, matching src/adpcm.cpp: 4-byte header (predictor, step index)
+# holding the state before the first sample, then low-nibble-first codes.
+
+ADPCM_STEPS = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+]
+ADPCM_INDEX = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+class AdpcmState:
+    def __init__(self, predictor: int = 0, step_index: int = 0):
+        self.predictor = predictor
+        self.step_index = step_index
+    
+    def step(self, code: int):
+        step = ADPCM_STEPS[self.step_index]
+        diff = step >> 3
+        if code & 4: diff += step
+        if code & 2: diff += step >> 1
+        if code & 1: diff += step >> 2
+        if code & 8: diff = -diff
+        self.predictor = max(-32768, min(32767, self.predictor + diff))
+        self.step_index = max(0, min(88, self.step_index + ADPCM_INDEX[code]))
+    
+    def encode_sample(self, sample: int) -> int:
+        step = ADPCM_STEPS[self.step_index]
+        diff = sample - self.predictor
+        code = 0
+        if diff < 0:
+            code = 8
+            diff = -diff
+        if diff >= step:
+            code |= 4
+            diff -= step
+        step >>= 1
+        if diff >= step:
+            code |= 2
+            diff -= step
+        step >>= 1
+        if diff >= step:
+            code |= 1
+        self.step(code)
+        return code
+
+def adpcm_encode_block(state: AdpcmState, pcm: np.ndarray) -> bytes:
+    """Encode int16 samples into one self-contained block"""
+    out = bytearray(int(state.predictor).to_bytes(2, 'little', signed=True))
+    out += bytes([state.step_index, 0])
+    samples = pcm.tolist()
+    if len(samples) % 2:
+        samples.append(samples[-1])
+    for i in range(0, len(samples), 2):
+        lo = state.encode_sample(samples[i])
+        hi = state.encode_sample(samples[i + 1])
+        out.append(lo | (hi << 4))
+    return bytes(out)
+
+def adpcm_decode_block(data: bytes) -> bytes:
+    """Decode one block into int16 PCM bytes"""
+    if len(data) < 4 or data[2] > 88:
+        return b''
+    state = AdpcmState(int.from_bytes(data[0:2], 'little', signed=True), data[2])
+    pcm = np.empty((len(data) - 4) * 2, dtype=np.int16)
+    for i, byte in enumerate(data[4:]):
+        state.step(byte & 0x0F)
+        pcm[2 * i] = state.predictor
+        state.step(byte >> 4)
+        pcm[2 * i + 1] = state.predictor
+    return pcm.tobytes()
+
 # ==================== DEVICE SESSION ====================
 
 class DeviceSession:
@@ -53,12 +432,93 @@ class DeviceSession:
         self.audio_source = None
         self.is_active = False
         self.audio_frames_sent = 0
+        self.audio_samples_sent = 0
+        self.preroll_samples = 0
+        self.silence_samples = 0
+        self.uplink_codec = 'pcm16'
+        self.downlink_codec = 'pcm16'
+        self.device_downlink_codecs = ['pcm16', 'adpcm']
+        self.opus_decoder = None
+        self.uplink_stats = StreamStats()
+        self.uplink_frame_bytes = 0
+        self.downlink_sequence = 0
+        self.binary_control = False
+        self.rtp = None  # RtpEndpoint once the device's audio goes over UDP
+        self.rtp_addr = None
+        self.uplink_ssrc = None
+        self.downlink_ssrc = random.getrandbits(32)
+        self.rtp_sequence = 0
+        self.rtp_uplink = asyncio.Queue()
+        self.rtp_task = None
+        
+    def enable_rtp(self, endpoint: 'RtpEndpoint', addr, ssrc: int):
+        """Move audio to RTP; the WebSocket keeps control"""
+        self.rtp = endpoint
+        self.rtp_addr = addr
+        self.uplink_ssrc = ssrc
+        endpoint.sessions[ssrc] = self
+        self.rtp_task = asyncio.create_task(self._consume_rtp())
+        logger.info(f"📡 Audio over RTP: device {addr[0]}:{addr[1]}, SSRC {ssrc:08x}")
+    
+    def disable_rtp(self):
+        if self.rtp is None:
+            return
+        self.rtp.sessions.pop(self.uplink_ssrc, None)
+        self.rtp_task.cancel()
+        self.rtp = None
+    
+    async def _consume_rtp(self):
+        """Uplink datagrams in arrival order (StreamStats drops the late ones)"""
+        while True:
+            await self.process_audio_chunk(await self.rtp_uplink.get())
+    
+    async def send_audio(self, message: bytes, marker: bool):
+        """One downlink audio message, over RTP when negotiated"""
+        if self.rtp is not None:
+            self.rtp.send(self, message, marker)
+        elif len(message) > DOWNLINK_FRAGMENT_BYTES:
+            await self.websocket.send([
+                message[i:i + DOWNLINK_FRAGMENT_BYTES]
+                for i in range(0, len(message), DOWNLINK_FRAGMENT_BYTES)
+            ])
+        else:
+            await self.websocket.send(message)
         
+    def set_uplink_codec(self, codec: str):
+        """Select how binary uplink messages are decoded"""
+        self.uplink_codec = codec
+        self.opus_decoder = opuslib.Decoder(SAMPLE_RATE, CHANNELS) if codec == 'opus' else None
+    
+    async def set_uplink_batching(self, latency_ms: int):
+        """Change how many capture frames the device coalesces per message"""
+        await self.send_message({'type': 'uplink_batching', 'latency_ms': latency_ms})
+    
+    def decode_uplink(self, codec: str, payload: bytes) -> bytes:
+        """Turn one uplink payload into raw int16 PCM"""
+        if codec == 'opus':
+            if self.opus_decoder is None:
+                return b''
+            return b''.join(
+                self.opus_decoder.decode(packet, OPUS_MAX_FRAME_SAMPLES)
+                for packet in split_opus_packets(payload)
+            )
+        if codec == 'adpcm':
+            return adpcm_decode_block(payload)
+        return payload
+    
     async def start_session(self, session_id: str, livekit_url: str, token: str):
         """Start a new chat session"""
         self.session_id = session_id
         self.is_active = True
         self.audio_frames_sent = 0
+        self.audio_samples_sent = 0
+        self.preroll_samples = 0
+        self.silence_samples = 0
+        self.uplink_stats = StreamStats()
+        self.uplink_frame_bytes = 0
+        
+        # Fresh decoder state per session
+        self.set_uplink_codec(self.uplink_codec)
         
         logger.info(f"🆕 Starting session: {session_id}")
         
@@ -91,11 +551,17 @@ class DeviceSession:
                 logger.info(f"🔊 AI agent audio track subscribed")
                 asyncio.create_task(self._forward_agent_audio(track))
         
-        # Notify ESP32
-        await self.send_message({
+        # Notify ESP32 (with our RTP port when its audio comes over UDP)
+        started = {
             'type': 'session_started',
-            'session_id': session_id
-        })
+            'session_id': session_id,
+            'codec': self.uplink_codec,
+            'downlink_codec': self.downlink_codec
+        }
+        if self.rtp is not None:
+            started['rtp_port'] = RTP_PORT
+            started['ssrc'] = self.downlink_ssrc
+        await self.send_message(started)
         
         return self.room
     
@@ -105,6 +571,8 @@ class DeviceSession:
             return
         
         logger.info(f"✅ Ending session: {self.session_id}")
+        logger.info(f"📶 Uplink: {self.uplink_stats.summary()}, "
+                    f"pre-roll {self.preroll_samples / SAMPLE_RATE:.2f}s")
         
         self.is_active = False
         
@@ -130,8 +598,35 @@ class DeviceSession:
             return
         
         try:
-            # Convert to PCM
-            pcm = np.frombuffer(audio_data, dtype=np.int16)
+            # Convert to PCM (a message may hold several frames)
+            chunks = []
+            for codec, flags, sequence, timestamp_us, payload in unpack_audio_frames(audio_data):
+                silence = flags & AUDIO_FLAG_SILENCE
+                # A silence record is stamped at its first skipped sample, long
+                # before it is sent: no use as a jitter sample
+                missing = self.uplink_stats.track(sequence, None if silence else timestamp_us)
+                if missing < 0:
+                    continue
+                if silence:
+                    # In-band on RTP so it cannot overtake the audio before it
+                    chunk = bytes(2 * int.from_bytes(payload[:4], 'little'))
+                    self.silence_samples += len(chunk) // 2
+                else:
+                    chunk = self.decode_uplink(codec, payload)
+                    self.uplink_frame_bytes = len(chunk)
+                if missing:
+                    # Lost frames keep their time as silence, sized like the last
+                    # audio frame, so pauses and LiveKit's end-of-speech timing stay intact
+                    fill = min(missing * self.uplink_frame_bytes, SAMPLE_RATE * LOST_FILL_MS // 1000 * 2)
+                    chunks.append(bytes(fill))
+                if flags & AUDIO_FLAG_PREROLL:
+                    # Audio from before the button press; first words live here
+                    self.preroll_samples += len(chunk) // 2
+                chunks.append(chunk)
+            
+            pcm = np.frombuffer(b''.join(chunks), dtype=np.int16)
+            if len(pcm) == 0:
+                return
             
             # Create audio frame
             frame = rtc.AudioFrame.create(SAMPLE_RATE, CHANNELS, len(pcm))
@@ -143,23 +638,50 @@ class DeviceSession:
             
             self.audio_frames_sent += 1
             
-            # Log progress every second
-            if self.audio_frames_sent % 33 == 0:  # ~33 frames = 1 second @ 30ms chunks
-                duration = self.audio_frames_sent * 0.03
+            # Log progress every second (messages may carry several frames)
+            previous = self.audio_samples_sent
+            self.audio_samples_sent += len(pcm)
+            if self.audio_samples_sent // SAMPLE_RATE != previous // SAMPLE_RATE:
+                duration = self.audio_samples_sent / SAMPLE_RATE
                 logger.info(f"🎙️ Streaming: {duration:.1f}s")
         
         except Exception as e:
             logger.error(f"❌ Error processing audio: {e}")
     
+    async def process_silence(self, num_samples: int):
+        """Feed silence the device suppressed with its own VAD.
+
+        LiveKit's VAD needs to hear the pause to detect end of speech,
+        so skipped frames are replaced with zeros of the same duration.
+        """
+        if not self.is_active or not self.audio_source or num_samples <= 0:
+            return
+        
+        try:
+            frame = rtc.AudioFrame.create(SAMPLE_RATE, CHANNELS, num_samples)
+            await self.audio_source.capture_frame(frame)
+            self.silence_samples += num_samples
+        
+        except Exception as e:
+            logger.error(f"❌ Error processing silence: {e}")
+    
     async def _forward_agent_audio(self, track: rtc.Track):
         """Forward AI agent's audio to ESP32"""
         logger.info("🔊 Starting agent audio playback")
         
         # Notify ESP32 that agent is speaking
-        await self.send_message({'type': 'agent_speaking_start'})
+        await self.send_message({
+            'type': 'agent_speaking_start',
+            'sample_rate': DOWNLINK_SAMPLE_RATE
+        })
+        
+        adpcm_state = AdpcmState()
+        opus_encoder = OpusDownlinkEncoder() if self.downlink_codec == 'opus' else None
+        flags = AUDIO_FLAG_MARKER
         
         try:
-            audio_stream = rtc.AudioStream(track)
+            audio_stream = rtc.AudioStream(track, sample_rate=DOWNLINK_SAMPLE_RATE,
+                                           num_channels=CHANNELS)
             
             async for frame_event in audio_stream:
                 frame = frame_event.frame
@@ -171,12 +693,32 @@ class DeviceSession:
                     # Stereo to mono
                     samples = samples[::2]
                 
-                # Send to ESP32
-                try:
-                    await self.websocket.send(samples.tobytes())
-                except websockets.exceptions.ConnectionClosed:
-                    logger.info("❌ WebSocket closed during playback")
-                    break
+                # UDP datagrams must stay under the MTU; the WebSocket takes whole frames
+                if self.rtp is not None:
+                    pieces = [samples[i:i + RTP_MAX_SAMPLES] for i in range(0, len(samples), RTP_MAX_SAMPLES)]
+                else:
+                    pieces = [samples]
+                
+                for piece in pieces:
+                    if opus_encoder is not None:
+                        payload = opus_encoder.encode(piece, frame.sample_rate)
+                        if not payload:
+                            continue  # less than one Opus frame buffered so far
+                    elif self.downlink_codec == 'adpcm':
+                        payload = adpcm_encode_block(adpcm_state, piece)
+                    else:
+                        payload = piece.tobytes()
+                    
+                    message = pack_audio_frame(self.downlink_codec, flags,
+                                               self.downlink_sequence, now_us(), payload)
+                    self.downlink_sequence += 1
+                    
+                    # Send to ESP32
+                    await self.send_audio(message, bool(flags & AUDIO_FLAG_MARKER))
+                    flags = 0
+        
+        except websockets.exceptions.ConnectionClosed:
+            logger.info("❌ WebSocket closed during playback")
         
         except Exception as e:
             logger.error(f"❌ Error forwarding audio: {e}")
@@ -187,9 +729,12 @@ class DeviceSession:
             logger.info("✅ Agent finished speaking")
     
     async def send_message(self, msg: dict):
-        """Send JSON message to ESP32"""
+        """Send a control message to ESP32 (binary once negotiated, else JSON)"""
         try:
-            await self.websocket.send(json.dumps(msg))
+            if self.binary_control:
+                await self.websocket.send(encode_control(msg))
+            else:
+                await self.websocket.send(json.dumps(msg))
         except Exception as e:
             logger.error(f"❌ Error sending message: {e}")
 
@@ -201,6 +746,7 @@ class UMIBridge:
         self.livekit_url = LIVEKIT_URL
         self.api_key = LIVEKIT_API_KEY
         self.api_secret = LIVEKIT_API_SECRET
+        self.rtp = None  # RtpEndpoint, shared by all devices
     
     async def handle_device(self, websocket, path):
         """Handle WebSocket connection from ESP32"""
@@ -227,6 +773,7 @@ class UMIBridge:
             # Cleanup
             if session.is_active:
                 await session.end_session()
+            session.disable_rtp()
             
             if device_id in self.devices:
                 del self.devices[device_id]
@@ -236,39 +783,89 @@ class UMIBridge:
     async def _handle_message(self, session: DeviceSession, message):
         """Handle message from ESP32"""
         
-        # Binary = audio data
+        # Binary = audio data, or a control message once negotiated
         if isinstance(message, bytes):
-            await session.process_audio_chunk(message)
+            if message[:1] == bytes((CONTROL_MAGIC,)):
+                msg = decode_control(message)
+                if msg is None:
+                    logger.warning("⚠️ Malformed control message")
+                    return
+                await self._handle_control(session, msg)
+            else:
+                await session.process_audio_chunk(message)
         
         # Text = JSON command
         elif isinstance(message, str):
             try:
                 msg = json.loads(message)
-                msg_type = msg.get('type')
-                
-                if msg_type == 'device_info':
-                    device_id_str = msg.get('device_id')
-                    logger.info(f"📱 Device info: {device_id_str}")
-                    
-                    # Send ready confirmation
-                    await session.send_message({'type': 'ready'})
-                
-                elif msg_type == 'start_session':
-                    # Create new LiveKit room for this session
-                    session_id = msg.get('session_id')
-                    room_name = f"umi-{session_id}"
-                    
-                    # Generate token
-                    token = self._create_token(room_name, f"device-{session.device_id}")
-                    
-                    # Start session
-                    await session.start_session(session_id, self.livekit_url, token)
-                
-                elif msg_type == 'end_session':
-                    await session.end_session()
-            
             except json.JSONDecodeError:
                 logger.warning(f"⚠️ Invalid JSON: {message}")
+                return
+            await self._handle_control(session, msg)
+    
+    async def _handle_control(self, session: DeviceSession, msg: dict):
+        """Handle a control message, whichever encoding it arrived in"""
+        msg_type = msg.get('type')
+        
+        if msg_type == 'device_info':
+            device_id_str = msg.get('device_id')
+            logger.info(f"📱 Device info: {device_id_str}")
+            
+            # Pick the best uplink codec both sides support
+            device_codecs = msg.get('codecs', ['pcm16'])
+            codec = next((c for c in UPLINK_CODECS if c in device_codecs), 'pcm16')
+            session.set_uplink_codec(codec)
+            session.device_downlink_codecs = msg.get('downlink_codecs', ['pcm16', 'adpcm'])
+            logger.info(f"🎛️ Uplink codec: {codec}")
+            
+            # Audio over RTP/UDP when both sides can; the WebSocket keeps control
+            if self.rtp is not None and 'rtp_port' in msg and 'ssrc' in msg:
+                session.enable_rtp(self.rtp, (session.websocket.remote_address[0], int(msg['rtp_port'])),
+                                   int(msg['ssrc']))
+            
+            # Send ready confirmation (always JSON; binary applies after it)
+            binary = CONTROL_BINARY and msg.get('control') == 'binary'
+            session.binary_control = False
+            await session.send_message({
+                'type': 'ready',
+                'codec': codec,
+                'codecs': SUPPORTED_CODECS,
+                # One frame per datagram on UDP; larger PCM batches get IP-fragmented
+                'uplink_batch_ms': 30 if session.rtp is not None else UPLINK_BATCH_MS,
+                'control': 'binary' if binary else 'json'
+            })
+            session.binary_control = binary
+            logger.info(f"🧾 Control messages: {'binary' if binary else 'JSON'}")
+        
+        elif msg_type == 'start_session':
+            # Create new LiveKit room for this session
+            session_id = msg.get('session_id')
+            room_name = f"umi-{session_id}"
+            
+            # Per-session codec; the downlink prefers Opus, then mirrors ADPCM
+            codec = msg.get('codec', session.uplink_codec)
+            if codec not in SUPPORTED_CODECS:
+                logger.warning(f"⚠️ Unsupported codec {codec}, using pcm16")
+                codec = 'pcm16'
+            session.set_uplink_codec(codec)
+            session.downlink_codec = choose_downlink_codec(codec, session.device_downlink_codecs)
+            logger.info(f"🎛️ Downlink codec: {session.downlink_codec}")
+            
+            # Generate token
+            token = self._create_token(room_name, f"device-{session.device_id}")
+            
+            # Start session
+            await session.start_session(session_id, self.livekit_url, token)
+        
+        elif msg_type == 'silence':
+            await session.process_silence(int(msg.get('samples', 0)))
+        
+        elif msg_type == 'end_session':
+            if 'frames_captured' in msg:
+                logger.info(f"📊 Device capture: {msg.get('frames_captured')} frames, "
+                            f"{msg.get('frames_dropped', 0)} dropped, "
+                            f"{msg.get('frames_suppressed', 0)} suppressed by VAD")
+            await session.end_session()
     
     def _create_token(self, room_name: str, participant_name: str) -> str:
         """Create LiveKit access token"""
@@ -288,6 +885,11 @@ class UMIBridge:
         """Start WebSocket server"""
         logger.info(f"🌉 Starting bridge on ws://{WS_HOST}:{WS_PORT}")
         
+        if RTP_ENABLED:
+            _, self.rtp = await asyncio.get_running_loop().create_datagram_endpoint(
+                RtpEndpoint, local_addr=(WS_HOST, RTP_PORT))
+            logger.info(f"📡 RTP audio on udp://{WS_HOST}:{RTP_PORT}")
+        
         async with websockets.serve(
             self.handle_device,
             WS_HOST,
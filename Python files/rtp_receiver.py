@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""
+UMI RTP Receiver - stand-in for the bridge's UDP audio port
+===========================================================
+
+Listens where the bridge would (RTP_PORT) and reports, per SSRC, what the
+network did to the audio: packets, loss and reordering from the RTP
+sequence, RFC 3550 interarrival jitter and latency from the 1 MHz RTP
+timestamp. Needs nothing but the standard library.
+
+The device's clock is not ours, so latency against real hardware is the
+delay above the fastest packet seen (queueing, retries, bursts). With
+--simulate the sender runs here on the same clock and latency is absolute.
+
+Usage:
+  python3 rtp_receiver.py                       # point a device at this host
+  python3 rtp_receiver.py --simulate --loss 2 --jitter-ms 15
+"""
+
+import argparse
+import asyncio
+import random
+import struct
+import time
+
+# Matches include/rtp_header.h and include/audio_frame_header.h
+RTP_HEADER = struct.Struct('>BBHII')
+RTP_VERSION_BYTE = 0x80
+RTP_PAYLOAD_TYPE = 96
+RTP_MARKER = 0x80
+
+AUDIO_HEADER = struct.Struct('<BBBBHHI')
+AUDIO_HEADER_VERSION = 0xA1
+CODEC_NAMES = {0: 'pcm16', 1: 'opus', 2: 'adpcm'}
+
+RTP_PORT = 5004
+REPORT_SECONDS = 5
+
+def now_us() -> int:
+    return int(time.monotonic() * 1_000_000) & 0xFFFFFFFF
+
+def wrap32(value: int) -> int:
+    """Signed difference of two 32-bit clock values"""
+    return ((value + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+
+class SourceStats:
+    """One SSRC: counters since the last report"""
+
+    def __init__(self, ssrc: int, absolute: bool):
+        self.ssrc = ssrc
+        self.absolute = absolute
+        self.expected = None
+        self.min_transit = None
+        self.last_transit = None
+        self.jitter_us = 0.0
+        self.codec = '?'
+        self.reset()
+
+    def reset(self):
+        self.packets = 0
+        self.lost = 0
+        self.late = 0
+        self.bytes = 0
+        self.latencies = []
+
+    def track(self, sequence: int, timestamp_us: int, arrival_us: int, size: int, message: bytes):
+        self.packets += 1
+        self.bytes += size
+        if len(message) >= AUDIO_HEADER.size and message[0] == AUDIO_HEADER_VERSION:
+            self.codec = CODEC_NAMES.get(message[1], '?')
+
+        if self.expected is not None:
+            delta = ((sequence - self.expected + 0x8000) & 0xFFFF) - 0x8000
+            if delta < 0:
+                self.late += 1  # counted as lost when its gap was seen
+                self.lost -= 1
+                return
+            self.lost += delta
+        self.expected = (sequence + 1) & 0xFFFF
+
+        # RFC 3550 6.4.1: J += (|D| - J) / 16, both clocks in us
+        transit = wrap32(arrival_us - timestamp_us)
+        if self.last_transit is not None:
+            self.jitter_us += (abs(transit - self.last_transit) - self.jitter_us) / 16
+        self.last_transit = transit
+
+        if self.min_transit is None or transit < self.min_transit:
+            self.min_transit = transit
+        self.latencies.append(transit if self.absolute else transit - self.min_transit)
+
+    def report(self, seconds: float) -> str:
+        sent = self.packets + max(self.lost, 0)
+        loss = 100 * max(self.lost, 0) / sent if sent else 0
+        latencies = sorted(self.latencies)
+        if latencies:
+            median = latencies[len(latencies) // 2] / 1000
+            p95 = latencies[min(len(latencies) - 1, len(latencies) * 95 // 100)] / 1000
+            latency = f"{'latency' if self.absolute else 'delay above best'} {median:.1f}/{p95:.1f} ms (p50/p95)"
+        else:
+            latency = "no latency samples"
+        return (f"📡 {self.ssrc:08x} {self.codec}: {self.packets} pkts, "
+                f"{self.bytes * 8 / seconds / 1000:.0f} kbit/s, "
+                f"{max(self.lost, 0)} lost ({loss:.1f}%), {self.late} reordered, "
+                f"jitter {self.jitter_us / 1000:.1f} ms, {latency}")
+
+class Receiver(asyncio.DatagramProtocol):
+
+    def __init__(self, absolute: bool):
+        self.absolute = absolute
+        self.sources = {}
+        self.foreign = 0
+
+    def datagram_received(self, data: bytes, addr):
+        arrival_us = now_us()
+        if len(data) < RTP_HEADER.size:
+            self.foreign += 1
+            return
+        version, mpt, sequence, timestamp_us, ssrc = RTP_HEADER.unpack_from(data)
+        if version != RTP_VERSION_BYTE or (mpt & ~RTP_MARKER) != RTP_PAYLOAD_TYPE:
+            self.foreign += 1
+            return
+
+        source = self.sources.get(ssrc)
+        if source is None:
+            source = self.sources[ssrc] = SourceStats(ssrc, self.absolute)
+            print(f"🆕 SSRC {ssrc:08x} from {addr[0]}:{addr[1]}")
+        source.track(sequence, timestamp_us, arrival_us, len(data), data[RTP_HEADER.size:])
+
+    def report(self, seconds: float):
+        for source in self.sources.values():
+            if source.packets:
+                print(source.report(seconds))
+            source.reset()
+        if self.foreign:
+            print(f"⚠️ {self.foreign} datagrams were not UMI RTP")
+            self.foreign = 0
+
+async def simulate(port: int, loss_pct: float, jitter_ms: float, frame_ms: int):
+    """Device-like sender: 16 kHz PCM frames with random loss and delay"""
+    loop = asyncio.get_running_loop()
+    transport, _ = await loop.create_datagram_endpoint(asyncio.DatagramProtocol,
+                                                       remote_addr=('127.0.0.1', port))
+    ssrc = random.getrandbits(32)
+    samples = 16 * frame_ms
+    payload = bytes(samples * 2)
+    sequence = 0
+
+    def send(packet: bytes):
+        if not transport.is_closing():
+            transport.sendto(packet)
+
+    print(f"🧪 Simulating SSRC {ssrc:08x}: {frame_ms} ms frames, "
+          f"{loss_pct}% loss, up to {jitter_ms} ms extra delay")
+    next_send = loop.time()
+    while True:
+        audio = AUDIO_HEADER.pack(AUDIO_HEADER_VERSION, 0, 0, 0, sequence & 0xFFFF,
+                                  len(payload), now_us()) + payload
+        packet = RTP_HEADER.pack(RTP_VERSION_BYTE, (RTP_MARKER if sequence == 0 else 0) | RTP_PAYLOAD_TYPE,
+                                 sequence & 0xFFFF, now_us(), ssrc) + audio
+        sequence += 1
+
+        # Delayed packets may overtake each other, as on a busy AP
+        if random.random() * 100 >= loss_pct:
+            loop.call_later(random.uniform(0, jitter_ms) / 1000, send, packet)
+
+        next_send += frame_ms / 1000
+        await asyncio.sleep(max(0, next_send - loop.time()))
+
+async def main():
+    parser = argparse.ArgumentParser(description="Stand-in RTP receiver for UMI audio")
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=RTP_PORT)
+    parser.add_argument('--interval', type=float, default=REPORT_SECONDS, help="seconds between reports")
+    parser.add_argument('--simulate', action='store_true', help="also run a sender on loopback")
+    parser.add_argument('--loss', type=float, default=0, help="simulated loss, percent")
+    parser.add_argument('--jitter-ms', type=float, default=0, help="simulated extra delay, 0..N ms")
+    parser.add_argument('--frame-ms', type=int, default=30, help="simulated frame length")
+    parser.add_argument('--duration', type=float, default=0, help="stop after N seconds (0 = never)")
+    args = parser.parse_args()
+
+    loop = asyncio.get_running_loop()
+    _, receiver = await loop.create_datagram_endpoint(lambda: Receiver(absolute=args.simulate),
+                                                      local_addr=(args.host, args.port))
+    print(f"📡 Listening for RTP on udp://{args.host}:{args.port}")
+
+    if args.simulate:
+        asyncio.create_task(simulate(args.port, args.loss, args.jitter_ms, args.frame_ms))
+
+    started = loop.time()
+    while not args.duration or loop.time() - started < args.duration:
+        await asyncio.sleep(args.interval)
+        receiver.report(args.interval)
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
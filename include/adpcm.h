@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * IMA-ADPCM, 4 bits per sample (4:1 against int16).
+ *
+ * A block is a 4-byte header carrying the coder state *before* its first
+ * sample, followed by packed nibbles (low nibble first). Every block can
+ * be decoded on its own, so a lost message never desynchronises the
+ * stream; the encoder still carries state across blocks for quality.
+ */
+
+#define ADPCM_HEADER_BYTES 4
+
+struct AdpcmState {
+  int16_t predictor = 0;
+  uint8_t stepIndex = 0;
+};
+
+inline size_t adpcmBlockBytes(size_t samples) {
+  return ADPCM_HEADER_BYTES + (samples + 1) / 2;
+}
+
+size_t adpcmWriteHeader(const AdpcmState& state, uint8_t* out);
+bool adpcmReadHeader(AdpcmState& state, const uint8_t* in, size_t length);
+
+// Packs samples into (samples + 1) / 2 bytes; an odd tail repeats the last sample
+size_t adpcmEncode(AdpcmState& state, const int16_t* pcm, size_t samples, uint8_t* out);
+
+// Unpacks 2 samples per input byte
+size_t adpcmDecode(AdpcmState& state, const uint8_t* in, size_t bytes, int16_t* pcm);
+
+// Header + nibbles in one call; returns adpcmBlockBytes(samples)
+size_t adpcmEncodeBlock(AdpcmState& state, const int16_t* pcm, size_t samples, uint8_t* out);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Logging that never waits for the UART.
+ *
+ * LOG_*() formats into a slot of a lock-free ring (any task may log; a
+ * slot is claimed with one compare-and-swap) and returns; a low-priority
+ * task copies finished slots to Serial. When the ring is full the message
+ * is dropped and counted, so a chatty moment costs log lines, not audio.
+ *
+ * Calls below UMI_LOG_LEVEL compile to nothing: their arguments are
+ * still type-checked but never evaluated.
+ */
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef UMI_LOG_LEVEL
+#define UMI_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_STRIPPED(...) do { if (false) asyncLog.write(__VA_ARGS__); } while (0)
+
+#if UMI_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) asyncLog.write(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_STRIPPED(__VA_ARGS__)
+#endif
+
+#if UMI_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) asyncLog.write(__VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_STRIPPED(__VA_ARGS__)
+#endif
+
+#if UMI_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) asyncLog.write(__VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_STRIPPED(__VA_ARGS__)
+#endif
+
+#if UMI_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) asyncLog.write(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_STRIPPED(__VA_ARGS__)
+#endif
+
+class AsyncLog {
+public:
+  static const size_t SLOTS = 32;          // power of two
+  static const size_t LINE_BYTES = 120;    // longer lines are cut (and end in "...")
+
+  AsyncLog();
+
+  // Starts the drain task; lines logged earlier wait in the ring
+  void begin(int core, unsigned priority);
+
+  // printf-style; a newline is added
+  void write(const char* format, ...) __attribute__((format(printf, 2, 3)));
+  void vwrite(const char* format, va_list args);
+
+  // Waits (up to timeoutMs) until the drain task has printed everything,
+  // e.g. before deep sleep
+  void flush(uint32_t timeoutMs);
+
+  // Lines lost to a full ring
+  std::atomic<uint32_t> dropped{0};
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> sequence;   // == position: free, == position + 1: filled
+    uint16_t length;
+    char text[LINE_BYTES];
+  };
+
+  static void drainTask(void* arg);
+  bool drainOne();
+
+  Slot slots_[SLOTS];
+  std::atomic<uint32_t> head_{0};     // next position to claim (producers)
+  std::atomic<uint32_t> tail_{0};     // next position to print (drain task)
+  bool started_ = false;
+};
+
+extern AsyncLog asyncLog;
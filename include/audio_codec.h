@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Audio codec identifiers shared with the bridge.
+ * The names are what travels in device_info / ready / start_session.
+ */
+
+enum AudioCodec : uint8_t {
+  CODEC_PCM16 = 0,   // raw little-endian int16
+  CODEC_OPUS = 1,    // [u16 len][packet]... per message
+  CODEC_ADPCM = 2,   // one IMA-ADPCM block per message (see adpcm.h)
+};
+
+inline const char* codecName(AudioCodec codec) {
+  switch (codec) {
+    case CODEC_OPUS: return "opus";
+    case CODEC_ADPCM: return "adpcm";
+    default:         return "pcm16";
+  }
+}
+
+// Unknown or missing names fall back to raw PCM
+inline AudioCodec codecFromName(const char* name) {
+  if (name && strcmp(name, "opus") == 0) return CODEC_OPUS;
+  if (name && strcmp(name, "adpcm") == 0) return CODEC_ADPCM;
+  return CODEC_PCM16;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Small fixed-point DSP kernels used on the audio paths.
+ */
+
+// Gains are 8.8 fixed point: 256 == unity, 768 == x3
+#define GAIN_Q8(g) ((int32_t)((g) * 256))
+
+// In place: samples[i] = saturate16(samples[i] * gainQ8 >> 8).
+// gainQ8 is clamped to int16 (x-128 .. x128).
+void applyGainSat(int16_t* samples, size_t count, int32_t gainQ8);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fixed 12-byte header in front of every binary audio payload, both
+ * directions. All fields little-endian:
+ *
+ *   0  u8   version     AUDIO_HEADER_VERSION
+ *   1  u8   codec       AudioCodec
+ *   2  u8   flags       AUDIO_FLAG_*
+ *   3  u8   reserved    0
+ *   4  u16  sequence    +1 per message, per direction
+ *   6  u16  length      payload bytes following the header
+ *   8  u32  timestamp   sender clock in us at the first sample (wraps)
+ *
+ * A WebSocket message may hold several [header][payload] records.
+ * With AUDIO_FLAG_SILENCE the payload is not audio but a u32 count of
+ * samples the VAD skipped (sent in-band on RTP, in order with the audio).
+ */
+
+#define AUDIO_HEADER_BYTES 12
+#define AUDIO_HEADER_VERSION 0xA1
+
+#define AUDIO_FLAG_MARKER 0x01   // first message after a gap (talkspurt start)
+#define AUDIO_FLAG_PREROLL 0x02  // captured before the session started
+#define AUDIO_FLAG_SILENCE 0x04  // payload: u32 samples of skipped silence
+
+#define AUDIO_SILENCE_BYTES 4
+
+struct AudioFrameHeader {
+  uint8_t codec;
+  uint8_t flags;
+  uint16_t sequence;
+  uint16_t length;
+  uint32_t timestampUs;
+};
+
+inline void writeAudioHeader(const AudioFrameHeader& h, uint8_t* out) {
+  out[0] = AUDIO_HEADER_VERSION;
+  out[1] = h.codec;
+  out[2] = h.flags;
+  out[3] = 0;
+  out[4] = (uint8_t)(h.sequence & 0xFF);
+  out[5] = (uint8_t)(h.sequence >> 8);
+  out[6] = (uint8_t)(h.length & 0xFF);
+  out[7] = (uint8_t)(h.length >> 8);
+  out[8] = (uint8_t)(h.timestampUs & 0xFF);
+  out[9] = (uint8_t)(h.timestampUs >> 8);
+  out[10] = (uint8_t)(h.timestampUs >> 16);
+  out[11] = (uint8_t)(h.timestampUs >> 24);
+}
+
+// Header only (AUDIO_HEADER_BYTES of input); false if the version is wrong
+inline bool parseAudioHeader(AudioFrameHeader& h, const uint8_t* in) {
+  if (in[0] != AUDIO_HEADER_VERSION) return false;
+  h.codec = in[1];
+  h.flags = in[2];
+  h.sequence = (uint16_t)(in[4] | (in[5] << 8));
+  h.length = (uint16_t)(in[6] | (in[7] << 8));
+  h.timestampUs = (uint32_t)in[8] | ((uint32_t)in[9] << 8) |
+                  ((uint32_t)in[10] << 16) | ((uint32_t)in[11] << 24);
+  return true;
+}
+
+// False if the bytes are not a valid header or the payload is truncated
+inline bool readAudioHeader(AudioFrameHeader& h, const uint8_t* in, size_t available) {
+  if (available < AUDIO_HEADER_BYTES || !parseAudioHeader(h, in)) return false;
+  return available - AUDIO_HEADER_BYTES >= h.length;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Control messages (device_info, ready, start_session, ...) in either of
+ * two encodings: JSON text, always understood, or a compact binary form
+ * the device offers in device_info ("control": "binary") and the bridge
+ * accepts in ready. One message per WebSocket binary message:
+ *
+ *   0  u8   magic    CONTROL_MAGIC (audio records start with 0xA1)
+ *   1  u8   type     ControlType
+ *   2  ...  fields   [u8 tag][u8 len][len bytes]...
+ *
+ * Integers are little-endian in the fewest of 1/2/4 bytes, strings raw
+ * UTF-8 without a terminator, codec lists a bit mask of AudioCodec ids.
+ * Unknown tags are skipped, so either side may add fields.
+ */
+
+#define CONTROL_MAGIC 0xC1
+#define CONTROL_MAX_BYTES 384       // largest binary message either side sends
+#define CONTROL_STRING_POOL 320     // all string fields of one message, terminated
+#define CONTROL_JSON_DOC_BYTES 512  // parsed JSON, after filtering to the wanted keys
+
+enum ControlType : uint8_t {
+  CONTROL_UNKNOWN = 0,
+  CONTROL_DEVICE_INFO,
+  CONTROL_READY,
+  CONTROL_START_SESSION,
+  CONTROL_SESSION_STARTED,
+  CONTROL_END_SESSION,
+  CONTROL_SESSION_ENDED,
+  CONTROL_SILENCE,
+  CONTROL_UPLINK_BATCHING,
+  CONTROL_VAD_CONFIG,
+  CONTROL_VAD_SPEECH_START,
+  CONTROL_VAD_SPEECH_END,
+  CONTROL_TRANSCRIPT,
+  CONTROL_AGENT_SPEAKING_START,
+  CONTROL_AGENT_SPEAKING_END,
+  CONTROL_TYPE_COUNT
+};
+
+// Wire tags; the JSON key of each is in the field table (control_message.cpp)
+enum ControlTag : uint8_t {
+  CTRL_SESSION_ID = 1,
+  CTRL_DEVICE_ID,
+  CTRL_CONTROL,
+  CTRL_TEXT,
+  CTRL_CODEC,
+  CTRL_CODECS,
+  CTRL_DOWNLINK_CODEC,
+  CTRL_DOWNLINK_CODECS,
+  CTRL_SAMPLE_RATE,
+  CTRL_CHANNELS,
+  CTRL_OPUS_FRAME_MS,
+  CTRL_OPUS_BITRATE,
+  CTRL_UPLINK_BATCH_MS,
+  CTRL_LATENCY_MS,
+  CTRL_SAMPLES,
+  CTRL_ENABLED,
+  CTRL_HANGOVER_FRAMES,
+  CTRL_ENERGY_MARGIN,     // 8.8 fixed point; a float in JSON
+  CTRL_MIN_ENERGY,
+  CTRL_IS_FINAL,
+  CTRL_FRAMES_CAPTURED,
+  CTRL_FRAMES_DROPPED,
+  CTRL_FRAMES_SUPPRESSED,
+  CTRL_FRAMES_SENT,
+  CTRL_RTP_PORT,          // UDP port the sender receives RTP audio on
+  CTRL_SSRC,              // the sender's RTP SSRC
+  CTRL_TAG_COUNT
+};
+
+#define CTRL_BIT(tag) (1UL << (tag))
+
+// FNV-1a; constexpr so message types can be switch labels
+constexpr uint32_t controlHash(const char* s, uint32_t hash = 2166136261u) {
+  return *s ? controlHash(s + 1, (hash ^ (uint8_t)*s) * 16777619u) : hash;
+}
+
+const char* controlTypeName(ControlType type);
+// Unknown, missing (null) or non-string names give CONTROL_UNKNOWN
+ControlType controlTypeFromName(const char* name);
+// Type of a JSON message, reading nothing but its "type" key
+ControlType peekControlType(const char* json, size_t length);
+
+class ControlMessage {
+public:
+  explicit ControlMessage(ControlType type = CONTROL_UNKNOWN) : type(type) {}
+
+  bool has(ControlTag tag) const { return present_ & (1UL << tag); }
+
+  // Missing fields read as the fallback, like `doc["key"] | fallback`
+  uint32_t getUint(ControlTag tag, uint32_t fallback) const;
+  bool getBool(ControlTag tag, bool fallback) const;
+  const char* getString(ControlTag tag, const char* fallback) const;
+
+  void setUint(ControlTag tag, uint32_t value);
+  void setBool(ControlTag tag, bool value) { setUint(tag, value ? 1 : 0); }
+  // Copies the string; false (and the field unset) if the pool is full
+  bool setString(ControlTag tag, const char* value, size_t length);
+  bool setString(ControlTag tag, const char* value);
+
+  void clear();
+
+  // Binary form: bytes written, or 0 if it does not fit
+  size_t encode(uint8_t* out, size_t capacity) const;
+  // False if the magic is wrong or a field is truncated
+  bool decode(const uint8_t* data, size_t length);
+
+  // JSON form: fills an empty document / reads a parsed one
+  void toJson(JsonDocument& doc) const;
+  bool fromJson(const JsonDocument& doc);
+  // Parses JSON text keeping only `fields` (CTRL_BIT mask); no heap use
+  bool parseJson(const char* json, size_t length, uint32_t fields);
+
+  ControlType type;
+
+private:
+  uint32_t present_ = 0;
+  uint32_t values_[CTRL_TAG_COUNT];   // integers / bools, or the string offset
+  char strings_[CONTROL_STRING_POOL];
+  size_t stringsUsed_ = 0;
+};
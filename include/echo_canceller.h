@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fixed-point NLMS acoustic echo canceller.
+ *
+ * Weights are Q28; the filter output uses their top bits (Q14) and the
+ * update a 32x32 high multiply, so the per-tap work is 32-bit on the
+ * ESP32-S3 and the step's divide happens once per 32 samples.
+ *
+ * The playback side pushes every block it hands to the DAC together with
+ * the time its first sample will be heard; the capture side passes mic
+ * frames with their capture time and gets the speaker's echo subtracted
+ * in place. Timestamps line the reference up with the mic, so the filter
+ * only has to model the room, not the DMA queues.
+ *
+ * Double talk is detected per frame: when a converged filter suddenly
+ * cancels less than 3 dB, the frame's adaptation is rolled back so near-end
+ * speech does not wreck the echo path estimate.
+ *
+ * One playback task pushes, one capture task processes; no locks.
+ */
+class EchoCanceller {
+public:
+  static const size_t TAPS = 256;          // 16 ms echo tail at 16 kHz
+  static const size_t MAX_BLOCK = 512;     // longer frames are processed in pieces
+
+  bool begin(uint32_t sampleRate, uint16_t stepQ15);
+  void reset();                            // applied on the next process()
+
+  // Playback side: samples about to be played, first one heard at playoutUs
+  void pushReference(const int16_t* pcm, size_t samples, uint32_t playoutUs);
+
+  // Capture side: removes the echo from mic in place
+  void process(int16_t* mic, size_t samples, uint32_t captureUs);
+
+  // Echo return loss enhancement over the far-end-only frames so far
+  float erleDb() const;
+
+  // Counters (frames)
+  uint32_t farEndFrames = 0;
+  uint32_t doubleTalkFrames = 0;
+  uint64_t echoEnergy = 0;                 // mic, far-end-only frames
+  uint64_t residualEnergy = 0;             // after cancellation, same frames
+
+private:
+  static const size_t REF_CAPACITY = 8192; // power of two, ~0.5 s
+  static const size_t REF_MAX_PUSH = 1024;
+
+  void applyReset();
+  void processBlock(int16_t* mic, size_t samples, uint32_t captureUs);
+  void loadReference(uint32_t captureUs, size_t samples);
+
+  uint32_t sampleRate_ = 16000;
+  uint16_t stepQ15_ = 0;
+
+  // Reference ring; refPos_ / refUs_ say when the next pushed sample plays
+  int16_t* ref_ = nullptr;
+  std::atomic<uint32_t> refSeq_{0};
+  std::atomic<uint32_t> refPos_{0};
+  std::atomic<uint32_t> refUs_{0};
+
+  // Capture side
+  std::atomic<bool> resetRequested_{false};
+  int32_t* weights_ = nullptr;             // Q28
+  int32_t* saved_ = nullptr;               // weights at the start of the frame
+  int16_t* x_ = nullptr;                   // TAPS - 1 history + block, aligned to mic
+  bool converged_ = false;
+  uint8_t rollbacks_ = 0;
+};
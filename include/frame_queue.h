@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Bounded FIFO of fixed-size frames, owned by a single task.
+ *
+ * Storage comes from PSRAM when available so long histories do not eat
+ * internal RAM. When full, push() recycles the oldest slot and counts
+ * it in `evicted`.
+ */
+template <typename T>
+class FrameQueue {
+public:
+  bool begin(size_t capacity) {
+    slots_ = (T*)ps_malloc(capacity * sizeof(T));
+    if (slots_ == NULL) {
+      slots_ = (T*)malloc(capacity * sizeof(T));
+    }
+    capacity_ = slots_ ? capacity : 0;
+    clear();
+    return slots_ != NULL;
+  }
+
+  // Slot to fill for the newest frame
+  T* push() {
+    if (capacity_ == 0) return NULL;
+    if (count_ == capacity_) {
+      head_ = (head_ + 1) % capacity_;
+      count_--;
+      evicted++;
+    }
+    T* slot = &slots_[(head_ + count_) % capacity_];
+    count_++;
+    return slot;
+  }
+
+  T* front() { return count_ ? &slots_[head_] : NULL; }
+
+  void pop() {
+    if (count_ == 0) return;
+    head_ = (head_ + 1) % capacity_;
+    count_--;
+  }
+
+  void clear() {
+    head_ = 0;
+    count_ = 0;
+    evicted = 0;
+  }
+
+  size_t size() const { return count_; }
+  size_t capacity() const { return capacity_; }
+
+  uint32_t evicted = 0;
+
+private:
+  T* slots_ = NULL;
+  size_t capacity_ = 0;
+  size_t head_ = 0;
+  size_t count_ = 0;
+};
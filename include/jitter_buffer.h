@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Downlink jitter buffer with adaptive playout delay.
+ *
+ * The network side writes decoded PCM and reports the measured
+ * interarrival jitter; the playback side reads fixed-size blocks at the
+ * DAC's pace. Playout (re)starts only once the buffer holds the target
+ * depth (minDelay + 3 x jitter, capped at maxDelay). Underruns are
+ * concealed by replaying the last 10 ms three times, each at half the
+ * level (the consumer stays active() while it does), and a buffer that
+ * grows well past the target is trimmed back so latency does not creep up.
+ *
+ * One producer task and one consumer task; no locks.
+ */
+class JitterBuffer {
+public:
+  JitterBuffer() = default;
+  JitterBuffer(const JitterBuffer&) = delete;
+  JitterBuffer& operator=(const JitterBuffer&) = delete;
+  ~JitterBuffer();
+
+  bool begin(uint32_t sampleRate, uint32_t minDelayMs, uint32_t maxDelayMs);
+  void end();                // frees the buffers; write() and read() then do nothing
+
+  // Producer side
+  size_t write(const int16_t* pcm, size_t samples);
+  void updateJitter(uint32_t jitterUs);
+  void endOfStream();        // play out what is left without waiting for target
+  // Drops everything written so far; applied by the consumer on its next
+  // read, but audio written after this call is kept
+  void reset();
+
+  // Consumer side: always fills `samples`, with silence or concealment if
+  // needed; returns how many of them came from the buffer
+  size_t read(int16_t* out, size_t samples);
+  bool active();             // playing or concealing, or prebuffered enough to start
+
+  size_t depth() const;
+  uint32_t targetDepth() const { return target_.load(std::memory_order_relaxed); }
+
+  // Counters (samples unless noted)
+  volatile uint32_t underruns = 0;       // events
+  volatile uint32_t concealed = 0;
+  volatile uint32_t trimmed = 0;
+  volatile uint32_t overflowed = 0;
+
+private:
+  static const size_t CAPACITY = 16384;  // ~1 s at 16 kHz, power of two
+  static const size_t CONCEAL_SAMPLES_MS = 10;
+  static const uint8_t CONCEAL_REPEATS = 3;
+
+  void applyReset();
+  void conceal(int16_t* out, size_t samples);
+  void remember(const int16_t* out, size_t samples);
+
+  int16_t* ring_ = nullptr;
+  std::atomic<uint32_t> writePos_{0};
+  std::atomic<uint32_t> readPos_{0};
+  std::atomic<uint32_t> target_{0};
+  std::atomic<bool> ending_{false};
+  std::atomic<bool> resetRequested_{false};
+  std::atomic<uint32_t> resetPos_{0};   // writePos_ when reset() was called
+
+  uint32_t sampleRate_ = 16000;
+  uint32_t minDelay_ = 0;
+  uint32_t maxDelay_ = 0;
+
+  // Consumer-only state
+  bool playing_ = false;
+  int16_t* history_ = nullptr;
+  size_t historyLen_ = 0;
+  size_t historyPos_ = 0;
+  size_t concealPos_ = 0;
+  uint8_t concealCount_ = CONCEAL_REPEATS;   // < CONCEAL_REPEATS: still concealing
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#if UMI_ENABLE_OPUS
+
+#include <stddef.h>
+#include <stdint.h>
+#include <opus.h>
+
+/*
+ * Streaming Opus encoder for the uplink.
+ *
+ * Capture frames (30 ms) are not a legal Opus frame size, so input is
+ * re-chunked into frameMs packets. Each packet is written as
+ * [u16 little-endian length][payload]. DTX packets (<= 2 bytes) are
+ * still sent: the bridge's decoder turns each into one frame of comfort
+ * noise, so pauses keep their length on the far side.
+ */
+class OpusUplinkEncoder {
+public:
+  static const size_t MAX_FRAME_SAMPLES = 960;   // 60 ms @ 16 kHz
+  static const size_t MAX_PACKET_BYTES = 400;
+
+  bool begin(int sampleRate, int frameMs, int bitrate, int complexity, bool dtx);
+  void end();
+  void reset();
+
+  // Returns bytes written to out (possibly 0 while a packet is pending)
+  size_t encode(const int16_t* pcm, size_t samples, uint8_t* out, size_t capacity);
+
+  bool ready() const { return encoder_ != NULL; }
+
+  // Samples buffered toward the next packet (they precede the next input)
+  size_t pendingSamples() const { return pendingCount_; }
+
+  uint32_t packets = 0;
+  uint32_t dtxPackets = 0;     // of packets; sent, but only 1-2 bytes each
+
+private:
+  OpusEncoder* encoder_ = NULL;
+  size_t frameSamples_ = 0;
+  int16_t pending_[MAX_FRAME_SAMPLES];
+  size_t pendingCount_ = 0;
+};
+
+/*
+ * Opus decoder for the downlink. Payloads use the same [u16 LE length]
+ * [packet] records as the uplink. The decoder runs at the playback rate
+ * whatever rate the bridge encoded at, so 48 kHz TTS needs no resampling.
+ */
+class OpusDownlinkDecoder {
+public:
+  static const size_t MAX_FRAME_SAMPLES = 960;   // 60 ms @ 16 kHz
+
+  bool begin(int sampleRate);
+  void end();
+  void reset();
+
+  // Decodes one packet; returns samples written to out (0 on error)
+  size_t decode(const uint8_t* packet, size_t length, int16_t* out, size_t capacity);
+
+  bool ready() const { return decoder_ != NULL; }
+
+  uint32_t packets = 0;
+  uint32_t errors = 0;
+
+private:
+  OpusDecoder* decoder_ = NULL;
+};
+
+#endif  // UMI_ENABLE_OPUS
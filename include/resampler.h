@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Streaming fixed-point polyphase resampler (rational L/M, L <= M).
+ *
+ * Covers the TTS rates seen on the downlink (48k, 24k, 22.05k -> 16k).
+ * The windowed-sinc prototype is designed once per rate change and
+ * split into L phases of Q15 taps; every output sample is one short
+ * dot product over the input history.
+ */
+class Resampler {
+public:
+  static const size_t MAX_INPUT = 480;       // per process() call
+
+  ~Resampler();
+
+  // False (and passthrough) for upsampling, ratios needing more than 320
+  // phases (e.g. 47999 Hz), or out of memory
+  bool begin(uint32_t inputRate, uint32_t outputRate);
+  void reset();
+
+  // Returns samples written; out must hold samples * L / M + 1
+  size_t process(const int16_t* in, size_t samples, int16_t* out);
+
+  bool passthrough() const { return coeffs_ == nullptr; }
+  uint32_t inputRate() const { return inputRate_; }
+
+private:
+  void release();
+
+  uint32_t inputRate_ = 0;
+  uint32_t up_ = 1;                // L
+  uint32_t down_ = 1;              // M
+  size_t taps_ = 0;                // per phase
+  int16_t* coeffs_ = nullptr;      // [phase][tap], newest input first
+  int16_t* history_ = nullptr;     // taps_ - 1 previous inputs + current block
+  uint32_t phase_ = 0;             // position between input samples, 0..L-1
+  size_t skip_ = 0;                // inputs the next output is already past
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * RTP (RFC 3550) framing for the optional UDP audio path. A datagram is
+ * one fixed RTP header followed by an ordinary audio message (the same
+ * [AudioFrameHeader][payload] records the WebSocket carries), so both
+ * transports share one parser. Big-endian, as RTP requires:
+ *
+ *   0  u8   0x80        version 2, no padding / extension / CSRCs
+ *   1  u8   M | PT      marker = talkspurt start, PT = RTP_PAYLOAD_TYPE
+ *   2  u16  sequence    +1 per datagram, per direction
+ *   4  u32  timestamp   sender clock in us (a 1 MHz RTP clock), wraps
+ *   8  u32  SSRC        exchanged in device_info / session_started
+ *
+ * Control (and the silence markers) stay on the WebSocket.
+ */
+
+#define RTP_HEADER_BYTES 12
+#define RTP_VERSION_BYTE 0x80
+#define RTP_PAYLOAD_TYPE 96   // dynamic: UMI audio records
+#define RTP_MARKER 0x80
+
+struct RtpHeader {
+  bool marker;
+  uint16_t sequence;
+  uint32_t timestamp;
+  uint32_t ssrc;
+};
+
+inline void writeRtpHeader(const RtpHeader& h, uint8_t* out) {
+  out[0] = RTP_VERSION_BYTE;
+  out[1] = (h.marker ? RTP_MARKER : 0) | RTP_PAYLOAD_TYPE;
+  out[2] = (uint8_t)(h.sequence >> 8);
+  out[3] = (uint8_t)(h.sequence & 0xFF);
+  out[4] = (uint8_t)(h.timestamp >> 24);
+  out[5] = (uint8_t)(h.timestamp >> 16);
+  out[6] = (uint8_t)(h.timestamp >> 8);
+  out[7] = (uint8_t)(h.timestamp & 0xFF);
+  out[8] = (uint8_t)(h.ssrc >> 24);
+  out[9] = (uint8_t)(h.ssrc >> 16);
+  out[10] = (uint8_t)(h.ssrc >> 8);
+  out[11] = (uint8_t)(h.ssrc & 0xFF);
+}
+
+// False if the datagram is too short or not our version / payload type
+inline bool readRtpHeader(RtpHeader& h, const uint8_t* in, size_t available) {
+  if (available < RTP_HEADER_BYTES || in[0] != RTP_VERSION_BYTE) return false;
+  if ((in[1] & ~RTP_MARKER) != RTP_PAYLOAD_TYPE) return false;
+  h.marker = (in[1] & RTP_MARKER) != 0;
+  h.sequence = (uint16_t)((in[2] << 8) | in[3]);
+  h.timestamp = ((uint32_t)in[4] << 24) | ((uint32_t)in[5] << 16) |
+                ((uint32_t)in[6] << 8) | (uint32_t)in[7];
+  h.ssrc = ((uint32_t)in[8] << 24) | ((uint32_t)in[9] << 16) |
+           ((uint32_t)in[10] << 8) | (uint32_t)in[11];
+  return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Lock-free single-producer / single-consumer ring of fixed-size slots.
+ *
+ * The producer fills a slot in place (acquire -> commit) and the consumer
+ * reads it in place (peek -> release), so frames are never copied through
+ * the ring. Exactly one task may produce and exactly one may consume.
+ */
+template <typename T, size_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+  // Producer: next free slot, or nullptr when the ring is full
+  T* acquire() {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail >= N) return nullptr;
+    return &slots_[head & (N - 1)];
+  }
+
+  // Producer: publish the slot returned by acquire()
+  void commit() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // Consumer: oldest published slot, or nullptr when the ring is empty
+  T* peek() {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t head = head_.load(std::memory_order_acquire);
+    if (head == tail) return nullptr;
+    return &slots_[tail & (N - 1)];
+  }
+
+  // Consumer: hand the slot returned by peek() back to the producer
+  void release() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t capacity() { return N; }
+
+private:
+  T slots_[N];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Lightweight fixed-point voice activity detector.
+ *
+ * Per frame: mean-square energy against an adaptive noise floor, plus a
+ * zero-crossing rate so quiet unvoiced consonants are not cut, plus a
+ * hangover so word tails and short pauses stay classified as speech.
+ * The floor is held during speech; a run of floorResetFrames hits in a
+ * row re-seeds it from the quietest of them, so a lasting rise in
+ * background noise cannot hold the gate open.
+ */
+
+struct VadConfig {
+  uint16_t energyMarginQ8;    // voiced: energy > noiseFloor * margin (8.8)
+  uint16_t unvoicedMarginQ8;  // unvoiced: lower margin, only with high ZCR
+  uint16_t minZcrUnvoiced;    // zero crossings per 1000 samples
+  uint32_t minEnergy;         // absolute mean-square floor for speech
+  uint8_t hangoverFrames;     // frames kept as speech after the last hit
+  uint16_t floorResetFrames;  // hits in a row before the floor is re-estimated
+};
+
+#define VAD_DEFAULT_CONFIG { \
+  /* energyMarginQ8   */ 4 * 256, \
+  /* unvoicedMarginQ8 */ 2 * 256, \
+  /* minZcrUnvoiced   */ 250, \
+  /* minEnergy        */ 2000, \
+  /* hangoverFrames   */ 10, \
+  /* floorResetFrames */ 333  /* 10 s of 30 ms frames */ \
+}
+
+class Vad {
+public:
+  void begin(const VadConfig& config);
+  void reset();
+
+  // Classifies one frame; true = speech (including hangover)
+  bool process(const int16_t* samples, size_t count);
+
+  VadConfig config;
+  uint32_t energy = 0;       // last frame, mean square
+  uint32_t noiseFloor = 0;
+  uint16_t zcr = 0;          // last frame, per 1000 samples
+
+private:
+  uint8_t hangover_ = 0;
+  bool primed_ = false;
+  uint16_t hitRun_ = 0;      // hits in a row
+  uint32_t hitMin_ = 0;      // quietest frame of the run
+};
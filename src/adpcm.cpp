@@ -0,0 +1,95 @@
+#include "adpcm.h"
+
+static const int16_t STEP_TABLE[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+  11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767
+};
+
+static const int8_t INDEX_TABLE[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static inline int16_t clamp16(int32_t x) {
+  return (int16_t)(x < -32768 ? -32768 : (x > 32767 ? 32767 : x));
+}
+
+static inline uint8_t clampIndex(int32_t i) {
+  return (uint8_t)(i < 0 ? 0 : (i > 88 ? 88 : i));
+}
+
+// Shared reconstruction so encoder and decoder track identical state
+static inline void step(AdpcmState& state, uint8_t code) {
+  int32_t stepSize = STEP_TABLE[state.stepIndex];
+  int32_t diff = stepSize >> 3;
+  if (code & 4) diff += stepSize;
+  if (code & 2) diff += stepSize >> 1;
+  if (code & 1) diff += stepSize >> 2;
+  if (code & 8) diff = -diff;
+
+  state.predictor = clamp16((int32_t)state.predictor + diff);
+  state.stepIndex = clampIndex((int32_t)state.stepIndex + INDEX_TABLE[code]);
+}
+
+static inline uint8_t encodeSample(AdpcmState& state, int16_t sample) {
+  int32_t stepSize = STEP_TABLE[state.stepIndex];
+  int32_t diff = (int32_t)sample - state.predictor;
+  uint8_t code = 0;
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+  if (diff >= stepSize) { code |= 4; diff -= stepSize; }
+  stepSize >>= 1;
+  if (diff >= stepSize) { code |= 2; diff -= stepSize; }
+  stepSize >>= 1;
+  if (diff >= stepSize) { code |= 1; }
+
+  step(state, code);
+  return code;
+}
+
+size_t adpcmWriteHeader(const AdpcmState& state, uint8_t* out) {
+  out[0] = (uint8_t)(state.predictor & 0xFF);
+  out[1] = (uint8_t)((uint16_t)state.predictor >> 8);
+  out[2] = state.stepIndex;
+  out[3] = 0;
+  return ADPCM_HEADER_BYTES;
+}
+
+bool adpcmReadHeader(AdpcmState& state, const uint8_t* in, size_t length) {
+  if (length < ADPCM_HEADER_BYTES || in[2] > 88) return false;
+  state.predictor = (int16_t)(in[0] | (in[1] << 8));
+  state.stepIndex = in[2];
+  return true;
+}
+
+size_t adpcmEncode(AdpcmState& state, const int16_t* pcm, size_t samples, uint8_t* out) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < samples; i += 2) {
+    uint8_t lo = encodeSample(state, pcm[i]);
+    uint8_t hi = encodeSample(state, pcm[i + 1 < samples ? i + 1 : i]);
+    out[bytes++] = (uint8_t)(lo | (hi << 4));
+  }
+  return bytes;
+}
+
+size_t adpcmDecode(AdpcmState& state, const uint8_t* in, size_t bytes, int16_t* pcm) {
+  for (size_t i = 0; i < bytes; i++) {
+    step(state, in[i] & 0x0F);
+    pcm[2 * i] = state.predictor;
+    step(state, in[i] >> 4);
+    pcm[2 * i + 1] = state.predictor;
+  }
+  return bytes * 2;
+}
+
+size_t adpcmEncodeBlock(AdpcmState& state, const int16_t* pcm, size_t samples, uint8_t* out) {
+  size_t header = adpcmWriteHeader(state, out);
+  return header + adpcmEncode(state, pcm, samples, out + header);
+}
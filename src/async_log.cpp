@@ -0,0 +1,101 @@
+#include "async_log.h"
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_DRAIN_STACK 3072
+#define LOG_DRAIN_IDLE_MS 10
+
+AsyncLog asyncLog;
+
+AsyncLog::AsyncLog() {
+  for (size_t i = 0; i < SLOTS; i++) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+void AsyncLog::begin(int core, unsigned priority) {
+  if (started_) return;
+  started_ = true;
+  xTaskCreatePinnedToCore(drainTask, "log", LOG_DRAIN_STACK, this, priority, NULL, core);
+}
+
+void AsyncLog::write(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vwrite(format, args);
+  va_end(args);
+}
+
+void AsyncLog::vwrite(const char* format, va_list args) {
+  // Claim a slot: bounded MPMC ring (Vyukov), used with a single consumer
+  uint32_t pos = head_.load(std::memory_order_relaxed);
+  Slot* slot;
+  for (;;) {
+    slot = &slots_[pos & (SLOTS - 1)];
+    int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = head_.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Room for "...\n" if the line is cut
+  int length = vsnprintf(slot->text, LINE_BYTES - 1, format, args);
+  if (length < 0) length = 0;
+  if ((size_t)length >= LINE_BYTES - 1) {
+    length = LINE_BYTES - 2;
+    memcpy(slot->text + length - 3, "...", 3);
+  }
+  slot->text[length++] = '\n';
+  slot->length = (uint16_t)length;
+
+  slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool AsyncLog::drainOne() {
+  uint32_t pos = tail_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[pos & (SLOTS - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != pos + 1) return false;
+
+  Serial.write((const uint8_t*)slot.text, slot.length);
+
+  slot.sequence.store(pos + SLOTS, std::memory_order_release);
+  tail_.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+void AsyncLog::drainTask(void* arg) {
+  AsyncLog* log = (AsyncLog*)arg;
+  uint32_t reportedDrops = 0;
+
+  for (;;) {
+    while (log->drainOne()) {}
+
+    uint32_t drops = log->dropped.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      char line[48];
+      int length = snprintf(line, sizeof(line), "⚠️ Log: %u lines dropped\n",
+                            (unsigned)(drops - reportedDrops));
+      Serial.write((const uint8_t*)line, length);
+      reportedDrops = drops;
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_IDLE_MS));
+  }
+}
+
+void AsyncLog::flush(uint32_t timeoutMs) {
+  if (!started_) return;
+  uint32_t start = millis();
+  while (tail_.load(std::memory_order_acquire) != head_.load(std::memory_order_relaxed) &&
+         millis() - start < timeoutMs) {
+    delay(1);
+  }
+  Serial.flush();
+}
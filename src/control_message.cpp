@@ -0,0 +1,305 @@
+#include "control_message.h"
+
+#include <string.h>
+
+#include "audio_codec.h"
+
+namespace {
+
+enum FieldKind : uint8_t { FIELD_UINT, FIELD_BOOL, FIELD_STRING, FIELD_CODEC, FIELD_CODEC_MASK, FIELD_Q8 };
+
+struct FieldInfo {
+  const char* key;
+  FieldKind kind;
+};
+
+// Indexed by ControlTag
+const FieldInfo FIELDS[CTRL_TAG_COUNT] = {
+  { nullptr,             FIELD_UINT },
+  { "session_id",        FIELD_STRING },
+  { "device_id",         FIELD_STRING },
+  { "control",           FIELD_STRING },
+  { "text",              FIELD_STRING },
+  { "codec",             FIELD_CODEC },
+  { "codecs",            FIELD_CODEC_MASK },
+  { "downlink_codec",    FIELD_CODEC },
+  { "downlink_codecs",   FIELD_CODEC_MASK },
+  { "sample_rate",       FIELD_UINT },
+  { "channels",          FIELD_UINT },
+  { "opus_frame_ms",     FIELD_UINT },
+  { "opus_bitrate",      FIELD_UINT },
+  { "uplink_batch_ms",   FIELD_UINT },
+  { "latency_ms",        FIELD_UINT },
+  { "samples",           FIELD_UINT },
+  { "enabled",           FIELD_BOOL },
+  { "hangover_frames",   FIELD_UINT },
+  { "energy_margin",     FIELD_Q8 },
+  { "min_energy",        FIELD_UINT },
+  { "is_final",          FIELD_BOOL },
+  { "frames_captured",   FIELD_UINT },
+  { "frames_dropped",    FIELD_UINT },
+  { "frames_suppressed", FIELD_UINT },
+  { "frames_sent",       FIELD_UINT },
+  { "rtp_port",          FIELD_UINT },
+  { "ssrc",              FIELD_UINT },
+};
+
+// Indexed by ControlType
+constexpr const char* TYPE_NAMES[CONTROL_TYPE_COUNT] = {
+  "unknown",
+  "device_info",
+  "ready",
+  "start_session",
+  "session_started",
+  "end_session",
+  "session_ended",
+  "silence",
+  "uplink_batching",
+  "vad_config",
+  "vad_speech_start",
+  "vad_speech_end",
+  "transcript",
+  "agent_speaking_start",
+  "agent_speaking_end",
+};
+
+const AudioCodec KNOWN_CODECS[] = { CODEC_PCM16, CODEC_OPUS, CODEC_ADPCM };
+
+}  // namespace
+
+const char* controlTypeName(ControlType type) {
+  return type < CONTROL_TYPE_COUNT ? TYPE_NAMES[type] : TYPE_NAMES[CONTROL_UNKNOWN];
+}
+
+ControlType controlTypeFromName(const char* name) {
+  if (!name) return CONTROL_UNKNOWN;
+
+  // Two types with the same hash would be duplicate labels and not compile
+  ControlType type;
+  switch (controlHash(name)) {
+#define CONTROL_TYPE_CASE(t) case controlHash(TYPE_NAMES[t]): type = t; break;
+    CONTROL_TYPE_CASE(CONTROL_DEVICE_INFO)
+    CONTROL_TYPE_CASE(CONTROL_READY)
+    CONTROL_TYPE_CASE(CONTROL_START_SESSION)
+    CONTROL_TYPE_CASE(CONTROL_SESSION_STARTED)
+    CONTROL_TYPE_CASE(CONTROL_END_SESSION)
+    CONTROL_TYPE_CASE(CONTROL_SESSION_ENDED)
+    CONTROL_TYPE_CASE(CONTROL_SILENCE)
+    CONTROL_TYPE_CASE(CONTROL_UPLINK_BATCHING)
+    CONTROL_TYPE_CASE(CONTROL_VAD_CONFIG)
+    CONTROL_TYPE_CASE(CONTROL_VAD_SPEECH_START)
+    CONTROL_TYPE_CASE(CONTROL_VAD_SPEECH_END)
+    CONTROL_TYPE_CASE(CONTROL_TRANSCRIPT)
+    CONTROL_TYPE_CASE(CONTROL_AGENT_SPEAKING_START)
+    CONTROL_TYPE_CASE(CONTROL_AGENT_SPEAKING_END)
+#undef CONTROL_TYPE_CASE
+    default: return CONTROL_UNKNOWN;
+  }
+
+  // Any other string may still share a known hash
+  return strcmp(name, TYPE_NAMES[type]) == 0 ? type : CONTROL_UNKNOWN;
+}
+
+ControlType peekControlType(const char* json, size_t length) {
+  StaticJsonDocument<JSON_OBJECT_SIZE(1)> filter;
+  filter["type"] = true;
+
+  StaticJsonDocument<JSON_OBJECT_SIZE(1) + 32> head;
+  DeserializationError error = deserializeJson(head, json, length,
+                                               DeserializationOption::Filter(filter));
+  if (error) return CONTROL_UNKNOWN;
+  return controlTypeFromName(head["type"]);
+}
+
+uint32_t ControlMessage::getUint(ControlTag tag, uint32_t fallback) const {
+  return has(tag) ? values_[tag] : fallback;
+}
+
+bool ControlMessage::getBool(ControlTag tag, bool fallback) const {
+  return has(tag) ? values_[tag] != 0 : fallback;
+}
+
+const char* ControlMessage::getString(ControlTag tag, const char* fallback) const {
+  return has(tag) ? strings_ + values_[tag] : fallback;
+}
+
+void ControlMessage::setUint(ControlTag tag, uint32_t value) {
+  values_[tag] = value;
+  present_ |= 1UL << tag;
+}
+
+bool ControlMessage::setString(ControlTag tag, const char* value, size_t length) {
+  if (stringsUsed_ + length + 1 > CONTROL_STRING_POOL) {
+    present_ &= ~(1UL << tag);
+    return false;
+  }
+  memcpy(strings_ + stringsUsed_, value, length);
+  strings_[stringsUsed_ + length] = '\0';
+  values_[tag] = stringsUsed_;
+  stringsUsed_ += length + 1;
+  present_ |= 1UL << tag;
+  return true;
+}
+
+bool ControlMessage::setString(ControlTag tag, const char* value) {
+  return setString(tag, value, strlen(value));
+}
+
+void ControlMessage::clear() {
+  type = CONTROL_UNKNOWN;
+  present_ = 0;
+  stringsUsed_ = 0;
+}
+
+size_t ControlMessage::encode(uint8_t* out, size_t capacity) const {
+  if (capacity < 2) return 0;
+  size_t n = 0;
+  out[n++] = CONTROL_MAGIC;
+  out[n++] = type;
+
+  for (uint8_t tag = 1; tag < CTRL_TAG_COUNT; tag++) {
+    if (!has((ControlTag)tag)) continue;
+
+    const uint8_t* value;
+    size_t length;
+    uint8_t scratch[4];
+    if (FIELDS[tag].kind == FIELD_STRING) {
+      value = (const uint8_t*)(strings_ + values_[tag]);
+      length = strlen((const char*)value);
+      if (length > 255) length = 255;
+    } else {
+      uint32_t v = values_[tag];
+      length = v > 0xFFFF ? 4 : v > 0xFF ? 2 : 1;
+      for (size_t i = 0; i < length; i++) scratch[i] = (uint8_t)(v >> (8 * i));
+      value = scratch;
+    }
+
+    if (n + 2 + length > capacity) return 0;
+    out[n++] = tag;
+    out[n++] = (uint8_t)length;
+    memcpy(out + n, value, length);
+    n += length;
+  }
+  return n;
+}
+
+bool ControlMessage::decode(const uint8_t* data, size_t length) {
+  clear();
+  if (length < 2 || data[0] != CONTROL_MAGIC) return false;
+  type = data[1] < CONTROL_TYPE_COUNT ? (ControlType)data[1] : CONTROL_UNKNOWN;
+
+  size_t pos = 2;
+  while (pos + 2 <= length) {
+    uint8_t tag = data[pos];
+    uint8_t fieldLength = data[pos + 1];
+    pos += 2;
+    if (pos + fieldLength > length) return false;
+    const uint8_t* value = data + pos;
+    pos += fieldLength;
+
+    if (tag == 0 || tag >= CTRL_TAG_COUNT) continue;
+    if (FIELDS[tag].kind == FIELD_STRING) {
+      setString((ControlTag)tag, (const char*)value, fieldLength);
+    } else if (fieldLength <= 4) {
+      uint32_t v = 0;
+      for (size_t i = 0; i < fieldLength; i++) v |= (uint32_t)value[i] << (8 * i);
+      setUint((ControlTag)tag, v);
+    }
+  }
+  return pos == length;
+}
+
+void ControlMessage::toJson(JsonDocument& doc) const {
+  doc["type"] = controlTypeName(type);
+
+  for (uint8_t tag = 1; tag < CTRL_TAG_COUNT; tag++) {
+    if (!has((ControlTag)tag)) continue;
+    const FieldInfo& field = FIELDS[tag];
+    uint32_t value = values_[tag];
+
+    switch (field.kind) {
+      case FIELD_STRING:
+        doc[field.key] = (const char*)(strings_ + value);
+        break;
+      case FIELD_BOOL:
+        doc[field.key] = value != 0;
+        break;
+      case FIELD_CODEC:
+        doc[field.key] = codecName((AudioCodec)value);
+        break;
+      case FIELD_CODEC_MASK: {
+        JsonArray list = doc.createNestedArray(field.key);
+        for (AudioCodec codec : KNOWN_CODECS) {
+          if (value & (1UL << codec)) list.add(codecName(codec));
+        }
+        break;
+      }
+      case FIELD_Q8:
+        doc[field.key] = value / 256.0f;
+        break;
+      default:
+        doc[field.key] = value;
+        break;
+    }
+  }
+}
+
+bool ControlMessage::fromJson(const JsonDocument& doc) {
+  clear();
+  type = controlTypeFromName(doc["type"]);
+
+  for (uint8_t tag = 1; tag < CTRL_TAG_COUNT; tag++) {
+    const FieldInfo& field = FIELDS[tag];
+    JsonVariantConst value = doc[field.key];
+    if (value.isNull()) continue;
+
+    switch (field.kind) {
+      case FIELD_STRING: {
+        const char* s = value.as<const char*>();
+        if (s) setString((ControlTag)tag, s);
+        break;
+      }
+      case FIELD_BOOL:
+        setBool((ControlTag)tag, value.as<bool>());
+        break;
+      case FIELD_CODEC:
+        setUint((ControlTag)tag, codecFromName(value.as<const char*>()));
+        break;
+      case FIELD_CODEC_MASK: {
+        uint32_t mask = 0;
+        for (JsonVariantConst codec : value.as<JsonArrayConst>()) {
+          mask |= 1UL << codecFromName(codec.as<const char*>());
+        }
+        setUint((ControlTag)tag, mask);
+        break;
+      }
+      case FIELD_Q8: {
+        float q8 = value.as<float>() * 256.0f;
+        setUint((ControlTag)tag, q8 > 0 ? (uint32_t)(q8 + 0.5f) : 0);
+        break;
+      }
+      default:
+        setUint((ControlTag)tag, value.as<uint32_t>());
+        break;
+    }
+  }
+  return type != CONTROL_UNKNOWN;
+}
+
+bool ControlMessage::parseJson(const char* json, size_t length, uint32_t fields) {
+  StaticJsonDocument<JSON_OBJECT_SIZE(CTRL_TAG_COUNT)> filter;
+  filter["type"] = true;
+  for (uint8_t tag = 1; tag < CTRL_TAG_COUNT; tag++) {
+    if (fields & CTRL_BIT(tag)) filter[FIELDS[tag].key] = true;
+  }
+
+  // const input: strings are copied, so the text can be parsed twice
+  StaticJsonDocument<CONTROL_JSON_DOC_BYTES> doc;
+  DeserializationError error = deserializeJson(doc, json, length,
+                                               DeserializationOption::Filter(filter));
+  if (error) {
+    clear();
+    return false;
+  }
+  return fromJson(doc);
+}
@@ -0,0 +1,193 @@
+#include "echo_canceller.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reference quieter than this (mean square) is treated as no far end
+#define AEC_FAR_END_MIN_ENERGY 100
+// Regularisation of the NLMS step so near-silent reference cannot blow it up
+#define AEC_POWER_FLOOR ((int64_t)EchoCanceller::TAPS * 1024)
+// Consecutive rolled-back frames after which the echo path is assumed changed
+#define AEC_MAX_ROLLBACKS 50
+// Samples sharing one reciprocal of the reference power (one divide each)
+#define AEC_STEP_BLOCK 32
+
+bool EchoCanceller::begin(uint32_t sampleRate, uint16_t stepQ15) {
+  sampleRate_ = sampleRate;
+  stepQ15_ = stepQ15;
+  ref_ = (int16_t*)calloc(REF_CAPACITY, sizeof(int16_t));
+  weights_ = (int32_t*)calloc(TAPS, sizeof(int32_t));
+  saved_ = (int32_t*)calloc(TAPS, sizeof(int32_t));
+  x_ = (int16_t*)calloc(TAPS + MAX_BLOCK, sizeof(int16_t));  // +1: see processBlock
+  reset();
+  applyReset();
+  return ref_ && weights_ && saved_ && x_;
+}
+
+void EchoCanceller::reset() {
+  resetRequested_.store(true, std::memory_order_release);
+}
+
+void EchoCanceller::applyReset() {
+  if (!resetRequested_.exchange(false, std::memory_order_acquire)) return;
+  if (weights_) memset(weights_, 0, TAPS * sizeof(int32_t));
+  converged_ = false;
+  rollbacks_ = 0;
+  farEndFrames = 0;
+  doubleTalkFrames = 0;
+  echoEnergy = 0;
+  residualEnergy = 0;
+}
+
+void EchoCanceller::pushReference(const int16_t* pcm, size_t samples, uint32_t playoutUs) {
+  if (!ref_ || samples > REF_MAX_PUSH) return;
+
+  uint32_t pos = refPos_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < samples; i++) {
+    ref_[(pos + i) & (REF_CAPACITY - 1)] = pcm[i];
+  }
+
+  // Seqlock: the capture side retries if it catches the anchor mid-update
+  uint32_t seq = refSeq_.load(std::memory_order_relaxed);
+  refSeq_.store(seq + 1, std::memory_order_release);
+  refPos_.store(pos + samples, std::memory_order_release);
+  refUs_.store(playoutUs + (uint32_t)((uint64_t)samples * 1000000 / sampleRate_),
+               std::memory_order_release);
+  refSeq_.store(seq + 2, std::memory_order_release);
+}
+
+// Fills x_ with the reference heard during [captureUs - TAPS, captureUs + samples)
+void EchoCanceller::loadReference(uint32_t captureUs, size_t samples) {
+  uint32_t seq, pos, us;
+  do {
+    seq = refSeq_.load(std::memory_order_acquire);
+    pos = refPos_.load(std::memory_order_acquire);
+    us = refUs_.load(std::memory_order_acquire);
+  } while ((seq & 1) || seq != refSeq_.load(std::memory_order_acquire));
+
+  int32_t aheadUs = (int32_t)(us - captureUs);
+  int32_t ahead = (int32_t)((int64_t)aheadUs * sampleRate_ / 1000000);
+  uint32_t start = pos - (uint32_t)ahead - (TAPS - 1);
+
+  for (size_t j = 0; j < TAPS - 1 + samples; j++) {
+    uint32_t p = start + j;
+    uint32_t age = pos - p;  // 1 = newest pushed sample
+    bool valid = age >= 1 && age <= REF_CAPACITY - REF_MAX_PUSH;
+    x_[j] = valid ? ref_[p & (REF_CAPACITY - 1)] : 0;
+  }
+}
+
+void EchoCanceller::process(int16_t* mic, size_t samples, uint32_t captureUs) {
+  if (!ref_) return;
+  applyReset();
+  while (samples > 0) {
+    size_t n = samples < MAX_BLOCK ? samples : MAX_BLOCK;
+    processBlock(mic, n, captureUs);
+    mic += n;
+    samples -= n;
+    captureUs += (uint32_t)((uint64_t)n * 1000000 / sampleRate_);
+  }
+}
+
+// Filter output, Q14 taps times samples. The sum may wrap on the way but
+// the result fits, so it is accumulated unsigned (wrapping is defined).
+static inline int32_t filterOutput(const int32_t* weights, const int16_t* xv) {
+  uint32_t acc = 0;
+  for (size_t k = 0; k < EchoCanceller::TAPS; k++) {
+    acc += (uint32_t)(weights[k] >> 14) * (uint32_t)xv[k];
+  }
+  return (int32_t)acc;
+}
+
+void EchoCanceller::processBlock(int16_t* mic, size_t samples, uint32_t captureUs) {
+  loadReference(captureUs, samples);
+
+  uint64_t refEnergy = 0;
+  for (size_t i = 0; i < samples; i++) {
+    int32_t s = x_[TAPS - 1 + i];
+    refEnergy += (uint32_t)(s * s);
+  }
+  if (refEnergy / samples < AEC_FAR_END_MIN_ENERGY) return;
+  farEndFrames++;
+
+  memcpy(saved_, weights_, TAPS * sizeof(int32_t));
+
+  int64_t power = 0;
+  for (size_t k = 0; k < TAPS; k++) {
+    power += (int32_t)x_[k] * x_[k];
+  }
+
+  // Everything per tap is 32-bit: Q14 taps for the output, a 32x32 high
+  // multiply for the update. 64-bit math is per sample or per step block.
+  uint64_t micEnergy = 0;
+  uint64_t errorEnergy = 0;
+  int32_t acc = filterOutput(weights_, x_);
+  for (size_t b = 0; b < samples; b += AEC_STEP_BLOCK) {
+    size_t end = b + AEC_STEP_BLOCK < samples ? b + AEC_STEP_BLOCK : samples;
+
+    // Step from the larger of the window powers at either edge of the
+    // block, so a far end getting louder within it cannot overshoot
+    int64_t endPower = power;
+    for (size_t i = b; i < end && i + 1 < samples; i++) {
+      int32_t in = x_[TAPS + i];
+      int32_t out = x_[i];
+      endPower += in * in - out * out;
+    }
+    int64_t stepPower = (endPower > power ? endPower : power) + AEC_POWER_FLOOR;
+    // 2^46 / power: at least 2^8 (full-scale window), at most 2^28 (floor)
+    int64_t inverse = ((int64_t)1 << 46) / stepPower;
+    power = endPower;
+
+    for (size_t i = b; i < end; i++) {
+      // xv[TAPS - 1] is the reference sample aligned with mic[i]
+      const int16_t* xv = x_ + i;
+
+      int32_t m = mic[i];
+      int32_t e = m - (acc >> 14);
+      if (e > 32767) e = 32767;
+      if (e < -32768) e = -32768;
+      mic[i] = (int16_t)e;
+      micEnergy += (uint32_t)(m * m);
+      errorEnergy += (uint32_t)(e * e);
+
+      // NLMS: w += mu * e * x / |x|^2 as w += (g * x * 2^16) >> 32,
+      // g = mu * e * 2^29 / |x|^2, clipped for near-silent windows
+      int64_t g = ((int64_t)stepQ15_ * e * inverse) >> 17;
+      if (g > INT32_MAX) g = INT32_MAX;
+      if (g < INT32_MIN) g = INT32_MIN;
+      int32_t g32 = (int32_t)g;
+
+      // Update and the next sample's output in one pass over the taps
+      // (x_ has one spare sample, so xv[TAPS] exists on the last one)
+      uint32_t next = 0;
+      for (size_t k = 0; k < TAPS; k++) {
+        int32_t w = weights_[k] + (int32_t)(((int64_t)g32 * (xv[k] * 65536)) >> 32);
+        weights_[k] = w;
+        next += (uint32_t)(w >> 14) * (uint32_t)xv[k + 1];
+      }
+      acc = (int32_t)next;
+    }
+  }
+
+  // A converged filter that suddenly cancels < 3 dB is hearing the near end
+  if (converged_ && errorEnergy * 2 > micEnergy) {
+    doubleTalkFrames++;
+    if (++rollbacks_ < AEC_MAX_ROLLBACKS) {
+      memcpy(weights_, saved_, TAPS * sizeof(int32_t));
+      return;
+    }
+    // Too long to be speech: the echo path changed, keep adapting
+    converged_ = false;
+  }
+  rollbacks_ = 0;
+
+  echoEnergy += micEnergy;
+  residualEnergy += errorEnergy;
+  if (errorEnergy * 4 < micEnergy) converged_ = true;
+}
+
+float EchoCanceller::erleDb() const {
+  if (residualEnergy == 0 || echoEnergy == 0) return 0.0f;
+  return 10.0f * log10f((float)echoEnergy / (float)residualEnergy);
+}
@@ -0,0 +1,168 @@
+#include "jitter_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+JitterBuffer::~JitterBuffer() {
+  end();
+}
+
+void JitterBuffer::end() {
+  free(ring_);
+  free(history_);
+  ring_ = nullptr;
+  history_ = nullptr;
+  historyPos_ = 0;
+  concealPos_ = 0;
+  concealCount_ = CONCEAL_REPEATS;
+  playing_ = false;
+}
+
+bool JitterBuffer::begin(uint32_t sampleRate, uint32_t minDelayMs, uint32_t maxDelayMs) {
+  end();
+  sampleRate_ = sampleRate;
+  minDelay_ = sampleRate * minDelayMs / 1000;
+  maxDelay_ = sampleRate * maxDelayMs / 1000;
+  if (maxDelay_ > CAPACITY / 2) maxDelay_ = CAPACITY / 2;
+  target_.store(minDelay_);
+
+  historyLen_ = sampleRate * CONCEAL_SAMPLES_MS / 1000;
+  ring_ = (int16_t*)calloc(CAPACITY, sizeof(int16_t));
+  history_ = (int16_t*)calloc(historyLen_, sizeof(int16_t));
+  return ring_ != nullptr && history_ != nullptr;
+}
+
+size_t JitterBuffer::write(const int16_t* pcm, size_t samples) {
+  if (!ring_) return 0;
+  ending_.store(false, std::memory_order_relaxed);
+
+  uint32_t w = writePos_.load(std::memory_order_relaxed);
+  uint32_t r = readPos_.load(std::memory_order_acquire);
+  size_t space = CAPACITY - (w - r);
+  if (samples > space) {
+    overflowed += samples - space;
+    samples = space;
+  }
+
+  size_t first = CAPACITY - (w & (CAPACITY - 1));
+  if (first > samples) first = samples;
+  memcpy(ring_ + (w & (CAPACITY - 1)), pcm, first * sizeof(int16_t));
+  memcpy(ring_, pcm + first, (samples - first) * sizeof(int16_t));
+
+  writePos_.store(w + samples, std::memory_order_release);
+  return samples;
+}
+
+void JitterBuffer::updateJitter(uint32_t jitterUs) {
+  uint32_t target = minDelay_ + (uint32_t)((uint64_t)jitterUs * 3 * sampleRate_ / 1000000);
+  if (target > maxDelay_) target = maxDelay_;
+  target_.store(target, std::memory_order_relaxed);
+}
+
+void JitterBuffer::endOfStream() {
+  ending_.store(true, std::memory_order_relaxed);
+}
+
+void JitterBuffer::reset() {
+  // Producer side, so writePos_ is ours to read; later writes survive
+  resetPos_.store(writePos_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  resetRequested_.store(true, std::memory_order_release);
+}
+
+size_t JitterBuffer::depth() const {
+  return writePos_.load(std::memory_order_acquire) - readPos_.load(std::memory_order_acquire);
+}
+
+void JitterBuffer::applyReset() {
+  if (resetRequested_.exchange(false, std::memory_order_acquire)) {
+    uint32_t mark = resetPos_.load(std::memory_order_relaxed);
+    if ((int32_t)(mark - readPos_.load(std::memory_order_relaxed)) > 0) {
+      readPos_.store(mark, std::memory_order_release);
+    }
+    playing_ = false;
+    concealCount_ = CONCEAL_REPEATS;
+  }
+}
+
+bool JitterBuffer::active() {
+  applyReset();
+  if (playing_ || concealCount_ < CONCEAL_REPEATS) return true;
+  size_t available = depth();
+  return available > 0 && (available >= target_.load(std::memory_order_relaxed) ||
+                           ending_.load(std::memory_order_relaxed));
+}
+
+void JitterBuffer::remember(const int16_t* out, size_t samples) {
+  for (size_t i = 0; i < samples; i++) {
+    history_[historyPos_] = out[i];
+    historyPos_ = (historyPos_ + 1) % historyLen_;
+  }
+  concealPos_ = historyPos_;
+  concealCount_ = 0;
+}
+
+// Replays the last 10 ms at half the level each time, then goes quiet
+void JitterBuffer::conceal(int16_t* out, size_t samples) {
+  size_t i = 0;
+  for (; i < samples && concealCount_ < CONCEAL_REPEATS; i++) {
+    out[i] = history_[concealPos_] >> (concealCount_ + 1);
+    concealPos_ = (concealPos_ + 1) % historyLen_;
+    if (concealPos_ == historyPos_) concealCount_++;
+  }
+  memset(out + i, 0, (samples - i) * sizeof(int16_t));
+  concealed += i;
+}
+
+size_t JitterBuffer::read(int16_t* out, size_t samples) {
+  if (!ring_) {
+    memset(out, 0, samples * sizeof(int16_t));
+    return 0;
+  }
+
+  applyReset();
+
+  uint32_t r = readPos_.load(std::memory_order_relaxed);
+  size_t available = writePos_.load(std::memory_order_acquire) - r;
+  uint32_t target = target_.load(std::memory_order_relaxed);
+  bool ending = ending_.load(std::memory_order_relaxed);
+
+  // Prebuffer up to the target depth before (re)starting playout
+  if (!playing_) {
+    if (available >= target || (ending && available > 0)) {
+      playing_ = true;
+    } else {
+      // Rebuffering after an underrun: the fade-out carries on meanwhile
+      conceal(out, samples);
+      return 0;
+    }
+  }
+
+  // Latency crept up (burst after a stall): skip back down to the target
+  if (available > target + maxDelay_ / 2) {
+    size_t excess = available - target;
+    r += excess;
+    available -= excess;
+    trimmed += excess;
+  }
+
+  size_t take = available < samples ? available : samples;
+  size_t first = CAPACITY - (r & (CAPACITY - 1));
+  if (first > take) first = take;
+  memcpy(out, ring_ + (r & (CAPACITY - 1)), first * sizeof(int16_t));
+  memcpy(out + first, ring_, (take - first) * sizeof(int16_t));
+  readPos_.store(r + take, std::memory_order_release);
+  if (take > 0) remember(out, take);
+
+  if (take < samples) {
+    if (ending) {
+      // Played out to the end: nothing is missing, so nothing to conceal
+      concealCount_ = CONCEAL_REPEATS;
+    } else {
+      underruns++;
+    }
+    conceal(out + take, samples - take);
+    // Rebuffer to the target before playing again
+    playing_ = false;
+  }
+  return take;
+}
@@ -1,8 +1,25 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WebSocketsClient.h>
+#include <WiFiUdp.h>
 #include <ArduinoJson.h>
-#include <driver/i2s.h>
+#include <driver/i2s_std.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include "spsc_ring.h"
+#include "audio_dsp.h"
+#include "vad.h"
+#include "audio_codec.h"
+#include "opus_codec.h"
+#include "adpcm.h"
+#include "audio_frame_header.h"
+#include "rtp_header.h"
+#include "frame_queue.h"
+#include "jitter_buffer.h"
+#include "echo_canceller.h"
+#include "resampler.h"
+#include "control_message.h"
+#include "async_log.h"
 
 /*
  * UMI - LiveKit VAD Edition
@@ -20,6 +37,10 @@ const char* WIFI_PASSWORD = "Your-WiFi-Password";
 const char* BRIDGE_HOST = "192.168.1.100";
 const uint16_t BRIDGE_PORT = 8765;
 
+// Per-session codec: "" = bridge's choice, or "pcm16" / "adpcm" / "opus".
+// Use "adpcm" on boards where Opus does not fit alongside everything else.
+const char* PREFERRED_CODEC = "";
+
 #define BUTTON_PIN 7
 #define LED_PIN 21
 
@@ -37,83 +58,299 @@ const uint16_t BRIDGE_PORT = 8765;
 #define CHUNK_SIZE 480  // 30ms chunks
 #define MIC_GAIN 3
 
+// Capture task (drains I2S DMA independently of the network loop)
+#define CAPTURE_RING_FRAMES 32     // ~1s of 30ms frames
+#define CAPTURE_TASK_CORE 0        // loop() runs on core 1
+#define CAPTURE_TASK_PRIORITY 5
+#define CAPTURE_TASK_STACK 4096
+
+// On-device VAD: silent frames are replaced by periodic silence markers
+#define VAD_ENABLED true
+#define VAD_KEEPALIVE_MS 300       // max silence covered by one marker
+#define VAD_LOOKBACK_FRAMES 2      // silent frames re-sent ahead of an onset
+
+// Pre-roll: mic keeps running while IDLE so a session starts with history
+#define PREROLL_ENABLED true
+#define PREROLL_MS 500
+#define PREROLL_FRAMES ((PREROLL_MS + 29) / 30)
+
+// Session start: audio is held until the bridge confirms with session_started
+#define SESSION_START_BUFFER_MS 3000   // beyond this the oldest frames are dropped
+#define SESSION_START_BUFFER_FRAMES ((SESSION_START_BUFFER_MS + 29) / 30)
+#define SESSION_START_TIMEOUT_MS 5000  // then stream anyway, as if confirmed
+
+// Opus uplink (used when the bridge selects it in its ready message)
+#define OPUS_FRAME_MS 20           // Opus has no 30ms mode; capture is re-chunked
+#define OPUS_BITRATE 24000
+#define OPUS_COMPLEXITY 3
+#define OPUS_DTX true
+
+// Uplink batching: N capture frames per WebSocket message (30/60/90 ms)
+#define UPLINK_BATCH_MS 30         // default; the bridge can change it at runtime
+#define UPLINK_BATCH_MAX_FRAMES 3
+#define UPLINK_MAX_SAMPLES (UPLINK_BATCH_MAX_FRAMES * CHUNK_SIZE)
+#define UPLINK_MAX_PAYLOAD (UPLINK_MAX_SAMPLES * sizeof(int16_t))  // raw PCM is the largest
+
+// Zero-copy send: buffers reserve room for the WebSocket frame header so
+// sendBIN(..., headerToPayload=true) neither allocates nor copies.
+// Set false to measure the copying path (see the stats at session end).
+#define UPLINK_ZERO_COPY true
+#define FRAME_HEADROOM (WEBSOCKETS_MAX_HEADER_SIZE + AUDIO_HEADER_BYTES)
+
+// Downlink playout: the jitter buffer holds minDelay + 3 x jitter before
+// playing; the speaker DMA is kept short so it does not add its own delay
+#define JITTER_MIN_MS 40
+#define JITTER_MAX_MS 300
+#define PLAYBACK_BLOCK 160         // 10ms pulled from the jitter buffer at a time
+#define SPEAKER_DMA_BUF_COUNT 4
+#define SPEAKER_DMA_BUF_LEN 240    // 4 x 15ms = 60ms in flight
+#define SPEAKER_QUEUE_US (SPEAKER_DMA_BUF_COUNT * SPEAKER_DMA_BUF_LEN * 1000000ULL / SAMPLE_RATE)
+
+// Echo cancellation: the mic keeps streaming while the agent speaks, so the
+// user can barge in. Set false to mute the mic during playback instead.
+#define AEC_ENABLED true
+#define AEC_STEP_Q15 8192          // NLMS step size, 0.25
+
+// Playback task (blocks in i2s_channel_write so the network loop never does)
+#define PLAYBACK_TASK_CORE 1
+#define PLAYBACK_TASK_PRIORITY 6   // above loop() and capture: the DAC must not starve
+#define PLAYBACK_TASK_STACK 4096
+
+// Logging: LOG_*() only queue lines; this task prints them between audio work.
+// Set UMI_LOG_LEVEL in build_flags to strip levels at compile time.
+#define LOG_TASK_CORE 0
+#define LOG_TASK_PRIORITY 1        // below capture; Serial waits never touch audio
+
+// TTS audio that beats agent_speaking_start is held, not dropped
+#define EARLY_DOWNLINK_BYTES 32768     // ~330ms of 48kHz PCM, in PSRAM when present
+#define EARLY_DOWNLINK_TIMEOUT_MS 1000 // then it is not the start of a reply
+
+// Fragmented downlink messages: records that cannot be streamed (Opus,
+// early audio) are reassembled one at a time, never the whole message
+#define DOWNLINK_RECORD_BYTES 2048
+
+// Control messages: offer the compact binary encoding in device_info;
+// JSON stays in use until the bridge accepts it in ready
+#define CONTROL_BINARY_ENABLED true
+
+// Fixed-size strings: nothing on the session path touches the heap
+#define SESSION_ID_BYTES 48
+#define DEVICE_ID_BYTES 16
+#define CONTROL_JSON_BYTES 512
+
+// Optional RTP/UDP audio path: the port is offered in device_info and used
+// when session_started names the bridge's; the WebSocket keeps control.
+// Keep uplink batching at 30 ms on UDP: bigger PCM datagrams get IP-fragmented.
+#define RTP_ENABLED true
+#define RTP_LOCAL_PORT 5004
+#define RTP_MAX_PACKET 1500
+
+#if UMI_ENABLE_OPUS
+// libopus needs far more stack than the default 8KB loop task
+SET_LOOP_TASK_STACK_SIZE(32 * 1024);
+#endif
+
 /* ==================== STATE ==================== */
 
 WebSocketsClient webSocket;
 
-enum State { DISCONNECTED, IDLE, IN_SESSION, SPEAKING };
-State currentState = DISCONNECTED;
+enum State { DISCONNECTED, IDLE, STARTING, IN_SESSION, SPEAKING };
+volatile State currentState = DISCONNECTED;
+
+struct AudioFrame {
+  uint8_t headroom[FRAME_HEADROOM];  // WS header + AudioFrameHeader, filled at send
+  int16_t data[CHUNK_SIZE];          // i2s_channel_read writes here, after the headroom
+  size_t samples;
+  uint32_t timestampUs;              // capture time of the first sample
+  bool speech;                       // VAD decision (always true when VAD is off)
+  uint8_t flags;                     // AUDIO_FLAG_* carried into the header
+};
+static_assert(offsetof(AudioFrame, data) == FRAME_HEADROOM, "headroom must touch the samples");
+static_assert(WEBSOCKETS_MAX_HEADER_SIZE >= RTP_HEADER_BYTES, "RTP header goes in the WS headroom");
+
+// Capture task -> loop(); the capture task is the only producer
+SpscRing<AudioFrame, CAPTURE_RING_FRAMES> captureRing;
+AudioFrame overflowFrame;         // DMA is drained here while the ring is full
+i2s_chan_handle_t micChannel = NULL;
+i2s_chan_handle_t speakerChannel = NULL;
+
+volatile uint32_t framesCaptured = 0;
+volatile uint32_t framesDropped = 0;  // ring overflows
+volatile uint32_t framesSent = 0;
+uint32_t messagesSent = 0;
+uint32_t uplinkBytesCopied = 0;   // memcpy on the send path, ours or the library's
+uint32_t uplinkSendCycles = 0;    // CPU cycles from frame hand-off to sendBIN return
+
+// Frames not yet sent (PSRAM): the pre-roll while IDLE, plus everything
+// captured while STARTING; flushed in order once session_started arrives
+FrameQueue<AudioFrame> pendingAudio;
+uint32_t sessionStartMs = 0;
+
+// VAD runs in the capture task; suppression happens in loop()
+Vad vad;
+volatile bool vadEnabled = VAD_ENABLED;
+uint32_t framesSuppressed = 0;
+uint32_t pendingSilenceSamples = 0;
+uint32_t pendingSilenceUs = 0;    // capture time of the first skipped sample
+AudioFrame vadLookback[VAD_LOOKBACK_FRAMES];
+uint8_t vadLookbackHead = 0;
+uint8_t vadLookbackCount = 0;
 
-int16_t audioBuffer[CHUNK_SIZE];
-String currentSessionId = "";
-bool isSpeakerMode = false;
+// Codecs: the bridge announces a default in ready; each session may override
+AudioCodec defaultCodec = CODEC_PCM16;
+uint32_t bridgeCodecMask = 1 << CODEC_PCM16;
+AudioCodec uplinkCodec = CODEC_PCM16;
+#if UMI_ENABLE_OPUS
+OpusUplinkEncoder opusEncoder;
+OpusDownlinkDecoder opusDecoder;
+#endif
+AdpcmState adpcmEncoder;
+
+// Encoded / batched messages: [WS headroom][AudioFrameHeader][payload]
+alignas(4) uint8_t uplinkMessage[FRAME_HEADROOM + UPLINK_MAX_PAYLOAD];
+#define UPLINK_PAYLOAD (uplinkMessage + FRAME_HEADROOM)
+uint16_t uplinkSequence = 0;
+bool uplinkMarker = true;         // next message starts a talkspurt
+
+// Downlink sequence / jitter tracking (RFC 3550 style estimator)
+uint16_t downlinkExpectedSeq = 0;
+bool downlinkSeqValid = false;
+int32_t downlinkLastTransitUs = 0;
+uint32_t downlinkJitterUs = 0;
+uint32_t downlinkLost = 0;
+uint32_t downlinkLate = 0;
+uint32_t downlinkMalformed = 0;
+
+// Decoded TTS audio waiting for the DAC; filled by the WebSocket
+// callback, drained by playbackTask
+JitterBuffer jitterBuffer;
+
+// PCM / ADPCM TTS arrives at the rate declared in agent_speaking_start
+Resampler downlinkResampler;
+
+// Reply latency: end of user speech / first downlink byte -> first DAC write
+TaskHandle_t playbackTaskHandle = NULL;
+
+// Downlink records (header + payload) received in IN_SESSION, already
+// sequence-tracked; played when agent_speaking_start catches up
+uint8_t* earlyDownlink = NULL;
+size_t earlyDownlinkLength = 0;
+uint32_t earlyDownlinkSinceMs = 0;
+uint32_t earlyDownlinkDropped = 0;
+
+// Parser state carried across WStype_FRAGMENT events. downlinkRecord holds
+// the header, then either the payload (collecting) or a partial sample /
+// ADPCM block header (streaming); fill < AUDIO_HEADER_BYTES = in a header.
+enum DownlinkRecordMode : uint8_t { RECORD_DROP, RECORD_STREAM_PCM, RECORD_STREAM_ADPCM, RECORD_COLLECT };
+uint8_t downlinkRecord[DOWNLINK_RECORD_BYTES];
+size_t downlinkRecordFill = 0;
+size_t downlinkRecordLeft = 0;    // payload bytes still to come
+AudioFrameHeader downlinkRecordHeader;
+DownlinkRecordMode downlinkRecordMode = RECORD_DROP;
+AdpcmState downlinkAdpcm;
+bool downlinkFragmented = false;  // inside a binary fragmented message
+volatile bool awaitingFirstAudio = false;
+volatile uint32_t speechEndUs = 0;
+volatile uint32_t downlinkFirstByteUs = 0;
+
+// Frames waiting to be coalesced; raw PCM batches build up in place in
+// uplinkMessage, everything else is staged here and encoded at flush
+int16_t uplinkBatchPcm[UPLINK_MAX_SAMPLES];
+size_t uplinkBatchSamples = 0;
+uint32_t uplinkBatchTimestampUs = 0;
+uint8_t uplinkBatchFlags = 0;
+uint8_t uplinkBatchFrames = 0;
+uint8_t uplinkBatchTarget = UPLINK_BATCH_MS / 30;
+
+char currentSessionId[SESSION_ID_BYTES] = "";
+bool sessionStartPending = false; // start_session sent, its session_started not yet seen
+bool binaryControl = false;       // negotiated in ready; see control_message.h
+
+// RTP audio (see rtp_header.h); rtpActive = this session's audio is on UDP
+WiFiUDP rtpSocket;
+bool rtpActive = false;
+IPAddress rtpBridgeIp;
+uint16_t rtpBridgePort = 0;
+uint32_t rtpSsrc = 0;             // ours, random per boot
+uint32_t rtpBridgeSsrc = 0;
+uint16_t rtpSequence = 0;
+uint32_t rtpForeign = 0;          // datagrams that were not the bridge's audio
+uint8_t rtpPacket[RTP_MAX_PACKET];
+
+// The agent is audible: mic frames are echo-cancelled (or discarded
+// without AEC) so it does not hear itself
+volatile bool isSpeakerMode = false;
+EchoCanceller echoCanceller;
+volatile uint32_t aecCycles = 0;
+
+/* ==================== FORWARD DECLARATIONS ==================== */
+
+void handleControlText(const char* json, size_t length);
+void handleControlBinary(const uint8_t* data, size_t length);
+void sendControl(const ControlMessage& msg);
+void handleDownlinkMessage(const uint8_t* data, size_t length);
+void handleDownlinkFragment(const uint8_t* data, size_t length, bool first, bool last);
+bool canEncode(AudioCodec codec);
+void setUplinkBatching(uint32_t latencyMs);
+void beginStreaming();
+void armFirstAudioTimer();
+void flushEarlyDownlink();
+void discardEarlyDownlink();
 
 /* ==================== I2S SETUP ==================== */
 
+// Mic on I2S0 (RX) and speaker on I2S1 (TX): both channels stay enabled,
+// so turning from listening to speaking needs no driver reinstall
 void setupI2SMic() {
-  i2s_driver_uninstall(I2S_NUM_0);
-  delay(100);
-  
-  i2s_config_t i2s_config = {
-    .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
-    .sample_rate = SAMPLE_RATE,
-    .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-    .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-    .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-    .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-    .dma_buf_count = 8,
-    .dma_buf_len = 512,
-    .use_apll = false,
-    .tx_desc_auto_clear = false,
-    .fixed_mclk = 0
-  };
+  i2s_chan_config_t chan_config = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+  chan_config.dma_desc_num = 8;
+  chan_config.dma_frame_num = 512;
+  i2s_new_channel(&chan_config, NULL, &micChannel);
   
-  i2s_pin_config_t pin_config = {
-    .bck_io_num = I2S_MIC_SCK,
-    .ws_io_num = I2S_MIC_WS,
-    .data_out_num = I2S_PIN_NO_CHANGE,
-    .data_in_num = I2S_MIC_SD
+  i2s_std_config_t std_config = {
+    .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(SAMPLE_RATE),
+    .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
+    .gpio_cfg = {
+      .mclk = I2S_GPIO_UNUSED,
+      .bclk = (gpio_num_t)I2S_MIC_SCK,
+      .ws = (gpio_num_t)I2S_MIC_WS,
+      .dout = I2S_GPIO_UNUSED,
+      .din = (gpio_num_t)I2S_MIC_SD,
+      .invert_flags = { .mclk_inv = false, .bclk_inv = false, .ws_inv = false }
+    }
   };
+  std_config.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
   
-  i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL);
-  i2s_set_pin(I2S_NUM_0, &pin_config);
-  i2s_zero_dma_buffer(I2S_NUM_0);
-  
-  isSpeakerMode = false;
-  Serial.println("✅ Mic ready");
+  i2s_channel_init_std_mode(micChannel, &std_config);
+  i2s_channel_enable(micChannel);
+  LOG_INFO("✅ Mic ready");
 }
 
 void setupI2SSpeaker() {
-  i2s_driver_uninstall(I2S_NUM_0);
-  delay(100);
-  
-  i2s_config_t i2s_config = {
-    .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
-    .sample_rate = SAMPLE_RATE,
-    .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-    .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
-    .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-    .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-    .dma_buf_count = 8,
-    .dma_buf_len = 512,
-    .use_apll = false,
-    .tx_desc_auto_clear = true,
-    .fixed_mclk = 0
-  };
+  i2s_chan_config_t chan_config = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_1, I2S_ROLE_MASTER);
+  chan_config.dma_desc_num = SPEAKER_DMA_BUF_COUNT;
+  chan_config.dma_frame_num = SPEAKER_DMA_BUF_LEN;
+  chan_config.auto_clear = true;   // silence, not a looping buffer, on underflow
+  i2s_new_channel(&chan_config, &speakerChannel, NULL);
   
-  i2s_pin_config_t pin_config = {
-    .bck_io_num = I2S_SPK_BCK,
-    .ws_io_num = I2S_SPK_WS,
-    .data_out_num = I2S_SPK_DOUT,
-    .data_in_num = I2S_PIN_NO_CHANGE
+  i2s_std_config_t std_config = {
+    .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(SAMPLE_RATE),
+    .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
+    .gpio_cfg = {
+      .mclk = I2S_GPIO_UNUSED,
+      .bclk = (gpio_num_t)I2S_SPK_BCK,
+      .ws = (gpio_num_t)I2S_SPK_WS,
+      .dout = (gpio_num_t)I2S_SPK_DOUT,
+      .din = I2S_GPIO_UNUSED,
+      .invert_flags = { .mclk_inv = false, .bclk_inv = false, .ws_inv = false }
+    }
   };
+  // Mono samples are sent on both slots by the hardware; no stereo expansion
+  std_config.slot_cfg.slot_mask = I2S_STD_SLOT_BOTH;
   
-  i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL);
-  i2s_set_pin(I2S_NUM_0, &pin_config);
-  i2s_zero_dma_buffer(I2S_NUM_0);
-  
-  isSpeakerMode = true;
-  Serial.println("🔊 Speaker ready");
+  i2s_channel_init_std_mode(speakerChannel, &std_config);
+  i2s_channel_enable(speakerChannel);
+  LOG_INFO("🔊 Speaker ready");
 }
 
 /* ==================== WEBSOCKET HANDLERS ==================== */
@@ -121,196 +358,1144 @@ void setupI2SSpeaker() {
 void webSocketEvent(WStype_t type, uint8_t* payload, size_t length) {
   switch(type) {
     case WStype_DISCONNECTED:
-      Serial.println("❌ Disconnected from bridge");
+      LOG_WARN("❌ Disconnected from bridge");
       currentState = DISCONNECTED;
+      sessionStartPending = false;
+      rtpActive = false;
+      defaultCodec = CODEC_PCM16;
+      bridgeCodecMask = 1 << CODEC_PCM16;
+      uplinkSequence = 0;
+      downlinkSeqValid = false;
       digitalWrite(LED_PIN, LOW);
       break;
       
     case WStype_CONNECTED:
       {
-        Serial.println("✅ Connected to bridge");
+        LOG_INFO("✅ Connected to bridge");
         currentState = IDLE;
+        binaryControl = false;
         digitalWrite(LED_PIN, HIGH);
         
         // Send device info
-        StaticJsonDocument<200> doc;
-        doc["type"] = "device_info";
-        doc["device_id"] = "umi-" + String((uint32_t)ESP.getEfuseMac(), HEX);
-        doc["sample_rate"] = SAMPLE_RATE;
-        doc["channels"] = 1;
+        char deviceId[DEVICE_ID_BYTES];
+        snprintf(deviceId, sizeof(deviceId), "umi-%x", (unsigned)(uint32_t)ESP.getEfuseMac());
         
-        String json;
-        serializeJson(doc, json);
-        webSocket.sendTXT(json);
-      }
-      break;
-      
-    case WStype_TEXT:
-      {
-        Serial.printf("📝 Message: %s\n", payload);
+        ControlMessage msg(CONTROL_DEVICE_INFO);
+        msg.setString(CTRL_DEVICE_ID, deviceId);
+        msg.setUint(CTRL_SAMPLE_RATE, SAMPLE_RATE);
+        msg.setUint(CTRL_CHANNELS, 1);
+        if (CONTROL_BINARY_ENABLED) {
+          msg.setString(CTRL_CONTROL, "binary");
+        }
+        if (RTP_ENABLED) {
+          msg.setUint(CTRL_RTP_PORT, RTP_LOCAL_PORT);
+          msg.setUint(CTRL_SSRC, rtpSsrc);
+        }
         
-        StaticJsonDocument<512> doc;
-        DeserializationError error = deserializeJson(doc, payload, length);
+        // Codecs we can encode; the bridge picks one in its ready message
+        uint32_t codecs = (1 << CODEC_PCM16) | (1 << CODEC_ADPCM);
+#if UMI_ENABLE_OPUS
+        if (opusEncoder.ready()) {
+          codecs |= 1 << CODEC_OPUS;
+          msg.setUint(CTRL_OPUS_FRAME_MS, OPUS_FRAME_MS);
+          msg.setUint(CTRL_OPUS_BITRATE, OPUS_BITRATE);
+        }
+#endif
+        msg.setUint(CTRL_CODECS, codecs);
         
-        if (!error) {
-          const char* msgType = doc["type"];
-          
-          if (strcmp(msgType, "session_started") == 0) {
-            currentSessionId = doc["session_id"].as<String>();
-            Serial.printf("🆕 Session started: %s\n", currentSessionId.c_str());
-            digitalWrite(LED_PIN, HIGH);
-          }
-          else if (strcmp(msgType, "session_ended") == 0) {
-            Serial.println("✅ Session ended");
-            currentSessionId = "";
-            currentState = IDLE;
-            digitalWrite(LED_PIN, LOW);
-          }
-          else if (strcmp(msgType, "vad_speech_start") == 0) {
-            Serial.println("🎤 VAD: Speech detected");
-          }
-          else if (strcmp(msgType, "vad_speech_end") == 0) {
-            Serial.println("🔇 VAD: Speech ended");
-          }
-          else if (strcmp(msgType, "transcript") == 0) {
-            const char* text = doc["text"];
-            bool isFinal = doc["is_final"] | false;
-            Serial.printf("📝 %s: %s\n", isFinal ? "FINAL" : "Partial", text);
-          }
-          else if (strcmp(msgType, "agent_speaking_start") == 0) {
-            Serial.println("🤖 AI started speaking");
-            currentState = SPEAKING;
-          }
-          else if (strcmp(msgType, "agent_speaking_end") == 0) {
-            Serial.println("✅ AI finished speaking");
-            if (currentState == SPEAKING) {
-              currentState = IN_SESSION;
-            }
-          }
+        // Codecs we can play; the bridge picks one per session
+        uint32_t downlinkCodecs = (1 << CODEC_PCM16) | (1 << CODEC_ADPCM);
+#if UMI_ENABLE_OPUS
+        if (opusDecoder.ready()) {
+          downlinkCodecs |= 1 << CODEC_OPUS;
         }
+#endif
+        msg.setUint(CTRL_DOWNLINK_CODECS, downlinkCodecs);
+        
+        sendControl(msg);
       }
       break;
       
+    case WStype_TEXT:
+      LOG_DEBUG("📝 Message: %s", (const char*)payload);
+      handleControlText((const char*)payload, length);
+      break;
+      
     case WStype_BIN:
+      if (length > 0 && payload[0] == CONTROL_MAGIC) {
+        handleControlBinary(payload, length);
+        break;
+      }
       // Received TTS audio from bridge
-      if (currentState == SPEAKING) {
-        playAudioChunk(payload, length);
+      handleDownlinkMessage(payload, length);
+      break;
+      
+    case WStype_FRAGMENT_BIN_START:
+      handleDownlinkFragment(payload, length, true, false);
+      break;
+      
+    case WStype_FRAGMENT:
+    case WStype_FRAGMENT_FIN:
+      // Text is never fragmented by the bridge; only continue binary messages
+      if (downlinkFragmented) {
+        handleDownlinkFragment(payload, length, false, type == WStype_FRAGMENT_FIN);
       }
       break;
   }
 }
 
-/* ==================== AUDIO FUNCTIONS ==================== */
+// Bridge -> device control messages, one handler per type; each only
+// sees the fields listed for it in CONTROL_HANDLERS
+void handleReady(const ControlMessage& msg) {
+  defaultCodec = (AudioCodec)msg.getUint(CTRL_CODEC, CODEC_PCM16);
+  if (!canEncode(defaultCodec)) {
+    defaultCodec = CODEC_PCM16;
+  }
+  
+  bridgeCodecMask = (1 << CODEC_PCM16) | (1 << defaultCodec) | msg.getUint(CTRL_CODECS, 0);
+  LOG_INFO("🎛️ Default codec: %s", codecName(defaultCodec));
+  
+  if (msg.has(CTRL_UPLINK_BATCH_MS)) {
+    setUplinkBatching(msg.getUint(CTRL_UPLINK_BATCH_MS, UPLINK_BATCH_MS));
+  }
+  
+  binaryControl = CONTROL_BINARY_ENABLED &&
+                  strcmp(msg.getString(CTRL_CONTROL, "json"), "binary") == 0;
+  LOG_INFO("🧾 Control messages: %s", binaryControl ? "binary" : "JSON");
+}
 
-void streamAudioChunk() {
-  if (currentState != IN_SESSION) return;
+void handleSessionStarted(const ControlMessage& msg) {
+  // Only the one reply to the start_session we sent: a late reply to a
+  // start the user cancelled must not take over the session after it
+  const char* sessionId = msg.getString(CTRL_SESSION_ID, "");
+  if (!sessionStartPending || strcmp(sessionId, currentSessionId) != 0 ||
+      (currentState != STARTING && currentState != IN_SESSION)) {
+    LOG_WARN("⚠️ Ignoring session_started for %s (pending: %s)",
+             sessionId, sessionStartPending ? currentSessionId : "none");
+    return;
+  }
+  sessionStartPending = false;
   
-  size_t bytesRead = 0;
-  esp_err_t result = i2s_read(
-    I2S_NUM_0,
-    audioBuffer,
-    CHUNK_SIZE * sizeof(int16_t),
-    &bytesRead,
-    10 / portTICK_PERIOD_MS
-  );
+  // The bridge names its RTP port only when it wants audio on UDP
+  rtpActive = RTP_ENABLED && msg.has(CTRL_RTP_PORT) && WiFi.hostByName(BRIDGE_HOST, rtpBridgeIp);
+  if (rtpActive) {
+    rtpBridgePort = msg.getUint(CTRL_RTP_PORT, 0);
+    rtpBridgeSsrc = msg.getUint(CTRL_SSRC, 0);
+    rtpSequence = 0;
+  }
   
-  if (result != ESP_OK || bytesRead == 0) return;
+  LOG_INFO("🆕 Session started: %s (after %u ms, downlink %s, audio over %s)",
+           currentSessionId, (unsigned)(millis() - sessionStartMs),
+           codecName((AudioCodec)msg.getUint(CTRL_DOWNLINK_CODEC, CODEC_PCM16)),
+           rtpActive ? "UDP" : "WebSocket");
+  digitalWrite(LED_PIN, HIGH);
   
-  int samplesRead = bytesRead / sizeof(int16_t);
+  if (currentState == STARTING) {
+    beginStreaming();
+  }
+}
+
+void handleSessionEnded(const ControlMessage& msg) {
+  // Same for the end of a cancelled session arriving after a new start
+  const char* sessionId = msg.getString(CTRL_SESSION_ID, nullptr);
+  if (sessionId && currentSessionId[0] && strcmp(sessionId, currentSessionId) != 0) {
+    LOG_WARN("⚠️ Ignoring session_ended for %s (current: %s)", sessionId, currentSessionId);
+    return;
+  }
   
-  // Apply gain
-  for (int i = 0; i < samplesRead; i++) {
-    int32_t boosted = (int32_t)audioBuffer[i] * MIC_GAIN;
-    audioBuffer[i] = (int16_t)constrain(boosted, -32768, 32767);
+  LOG_INFO("✅ Session ended");
+  discardEarlyDownlink();
+  rtpActive = false;
+  currentSessionId[0] = '\0';
+  sessionStartPending = false;
+  currentState = IDLE;
+  digitalWrite(LED_PIN, LOW);
+}
+
+void handleUplinkBatching(const ControlMessage& msg) {
+  setUplinkBatching(msg.getUint(CTRL_LATENCY_MS, 30));
+}
+
+// Runtime tuning of the on-device VAD
+void handleVadConfig(const ControlMessage& msg) {
+  vadEnabled = msg.getBool(CTRL_ENABLED, vadEnabled);
+  vad.config.hangoverFrames = msg.getUint(CTRL_HANGOVER_FRAMES, vad.config.hangoverFrames);
+  vad.config.energyMarginQ8 = msg.getUint(CTRL_ENERGY_MARGIN, vad.config.energyMarginQ8);
+  vad.config.minEnergy = msg.getUint(CTRL_MIN_ENERGY, vad.config.minEnergy);
+  LOG_INFO("🎚️ VAD %s, hangover %u, margin %.1f",
+           vadEnabled ? "on" : "off",
+           vad.config.hangoverFrames,
+           vad.config.energyMarginQ8 / 256.0f);
+}
+
+void handleVadSpeechStart(const ControlMessage& msg) {
+  LOG_INFO("🎤 VAD: Speech detected");
+}
+
+void handleVadSpeechEnd(const ControlMessage& msg) {
+  LOG_INFO("🔇 VAD: Speech ended");
+  speechEndUs = (uint32_t)esp_timer_get_time();
+  armFirstAudioTimer();
+}
+
+void handleTranscript(const ControlMessage& msg) {
+  // Partials arrive several times a second; only finals are worth the UART
+  if (msg.getBool(CTRL_IS_FINAL, false)) {
+    LOG_INFO("📝 FINAL: %s", msg.getString(CTRL_TEXT, ""));
+  } else {
+    LOG_DEBUG("📝 Partial: %s", msg.getString(CTRL_TEXT, ""));
   }
+}
+
+void handleAgentSpeakingStart(const ControlMessage& msg) {
+  uint32_t rate = msg.getUint(CTRL_SAMPLE_RATE, SAMPLE_RATE);
+  LOG_INFO("🤖 AI started speaking (%u Hz)", (unsigned)rate);
+  if (!downlinkResampler.begin(rate, SAMPLE_RATE)) {
+    LOG_WARN("⚠️ Can't resample %u Hz, playing as is", (unsigned)rate);
+  }
+  // Drops the previous reply only: the early audio flushed below is kept
+  jitterBuffer.reset();
+  if (!awaitingFirstAudio) armFirstAudioTimer();
+#if UMI_ENABLE_OPUS
+  opusDecoder.reset();  // the bridge starts a fresh encoder per utterance
+#endif
+  currentState = SPEAKING;
+  flushEarlyDownlink();
+}
+
+void handleAgentSpeakingEnd(const ControlMessage& msg) {
+  LOG_INFO("✅ AI finished speaking");
+  LOG_INFO("📶 Downlink: %u lost, %u late, %u malformed, jitter %u us",
+           (unsigned)downlinkLost, (unsigned)downlinkLate,
+           (unsigned)downlinkMalformed, (unsigned)downlinkJitterUs);
+  LOG_INFO("🔈 Playout: target %u ms, %u underruns, %u ms concealed, %u ms trimmed",
+           (unsigned)(jitterBuffer.targetDepth() * 1000 / SAMPLE_RATE),
+           (unsigned)jitterBuffer.underruns,
+           (unsigned)(jitterBuffer.concealed * 1000 / SAMPLE_RATE),
+           (unsigned)(jitterBuffer.trimmed * 1000 / SAMPLE_RATE));
+  jitterBuffer.endOfStream();
+  if (currentState == SPEAKING) {
+    currentState = IN_SESSION;
+  }
+}
+
+struct ControlHandler {
+  void (*handle)(const ControlMessage& msg);
+  uint32_t fields;   // CTRL_BIT mask; other JSON keys are never parsed
+};
+
+// Indexed by ControlType; NULL = not sent to the device, ignored
+const ControlHandler CONTROL_HANDLERS[CONTROL_TYPE_COUNT] = {
+  /* unknown              */ { NULL, 0 },
+  /* device_info          */ { NULL, 0 },
+  /* ready                */ { handleReady, CTRL_BIT(CTRL_CODEC) | CTRL_BIT(CTRL_CODECS) |
+                                            CTRL_BIT(CTRL_UPLINK_BATCH_MS) | CTRL_BIT(CTRL_CONTROL) },
+  /* start_session        */ { NULL, 0 },
+  /* session_started      */ { handleSessionStarted, CTRL_BIT(CTRL_SESSION_ID) | CTRL_BIT(CTRL_DOWNLINK_CODEC) |
+                                                     CTRL_BIT(CTRL_RTP_PORT) | CTRL_BIT(CTRL_SSRC) },
+  /* end_session          */ { NULL, 0 },
+  /* session_ended        */ { handleSessionEnded, 0 },
+  /* silence              */ { NULL, 0 },
+  /* uplink_batching      */ { handleUplinkBatching, CTRL_BIT(CTRL_LATENCY_MS) },
+  /* vad_config           */ { handleVadConfig, CTRL_BIT(CTRL_ENABLED) | CTRL_BIT(CTRL_HANGOVER_FRAMES) |
+                                                CTRL_BIT(CTRL_ENERGY_MARGIN) | CTRL_BIT(CTRL_MIN_ENERGY) },
+  /* vad_speech_start     */ { handleVadSpeechStart, 0 },
+  /* vad_speech_end       */ { handleVadSpeechEnd, 0 },
+  /* transcript           */ { handleTranscript, CTRL_BIT(CTRL_TEXT) | CTRL_BIT(CTRL_IS_FINAL) },
+  /* agent_speaking_start */ { handleAgentSpeakingStart, CTRL_BIT(CTRL_SAMPLE_RATE) },
+  /* agent_speaking_end   */ { handleAgentSpeakingEnd, 0 },
+};
+
+// JSON text: the type is hashed first, then only its handler's fields
+// are parsed. Missing / unknown types and bad JSON are dropped.
+void handleControlText(const char* json, size_t length) {
+  const ControlHandler& handler = CONTROL_HANDLERS[peekControlType(json, length)];
+  if (!handler.handle) return;
+  
+  ControlMessage msg;
+  if (msg.parseJson(json, length, handler.fields)) {
+    handler.handle(msg);
+  }
+}
+
+// Binary control message (starts with CONTROL_MAGIC)
+void handleControlBinary(const uint8_t* data, size_t length) {
+  ControlMessage msg;
+  if (!msg.decode(data, length)) return;
   
-  // Send to bridge (LiveKit VAD will handle detection)
-  webSocket.sendBIN((uint8_t*)audioBuffer, bytesRead);
+  LOG_DEBUG("📝 Message: %s (binary, %u bytes)",
+            controlTypeName(msg.type), (unsigned)length);
+  const ControlHandler& handler = CONTROL_HANDLERS[msg.type];
+  if (handler.handle) {
+    handler.handle(msg);
+  }
 }
 
-void playAudioChunk(uint8_t* data, size_t length) {
-  // Switch to speaker if needed
-  if (!isSpeakerMode) {
-    setupI2SSpeaker();
+// Device -> bridge control: binary once the bridge accepted it, else JSON
+void sendControl(const ControlMessage& msg) {
+  if (binaryControl) {
+    uint8_t message[CONTROL_MAX_BYTES];
+    size_t length = msg.encode(message, sizeof(message));
+    if (length > 0) {
+      webSocket.sendBIN(message, length);
+      return;
+    }
   }
   
-  int16_t* samples = (int16_t*)data;
-  int numSamples = length / 2;
+  StaticJsonDocument<CONTROL_JSON_BYTES> doc;
+  msg.toJson(doc);
   
-  // Convert mono to stereo
-  int32_t stereoBuffer[CHUNK_SIZE];
-  int chunks = (numSamples + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  char json[CONTROL_JSON_BYTES];
+  size_t length = serializeJson(doc, json, sizeof(json));
+  if (length == 0 || length >= sizeof(json) - 1) {
+    LOG_WARN("⚠️ %s too large for JSON, dropped", controlTypeName(msg.type));
+    return;
+  }
+  webSocket.sendTXT(json, length);
+}
+
+/* ==================== AUDIO FUNCTIONS ==================== */
+
+// Runs on its own core: I2S DMA -> echo canceller -> gain -> captureRing
+void captureTask(void* arg) {
+  for (;;) {
+    bool wanted = currentState == IN_SESSION || currentState == STARTING ||
+                  (AEC_ENABLED && currentState == SPEAKING) ||
+                  (PREROLL_ENABLED && currentState == IDLE);
+    
+    AudioFrame* frame = wanted ? captureRing.acquire() : NULL;
+    bool overflow = (frame == NULL);
+    if (overflow) {
+      // Keep draining DMA so the mic never stalls; this frame is lost
+      frame = &overflowFrame;
+    }
+    
+    size_t bytesRead = 0;
+    esp_err_t result = i2s_channel_read(
+      micChannel,
+      frame->data,
+      CHUNK_SIZE * sizeof(int16_t),
+      &bytesRead,
+      100
+    );
+    
+    if (result != ESP_OK || bytesRead == 0) continue;
+    
+    // The RX channel never stops; frames nobody wants are just discarded
+    if (!wanted || (isSpeakerMode && !AEC_ENABLED)) continue;
+    
+    framesCaptured++;
+    if (overflow) {
+      framesDropped++;
+      continue;
+    }
+    
+    frame->samples = bytesRead / sizeof(int16_t);
+    frame->timestampUs = (uint32_t)esp_timer_get_time() -
+                         (uint32_t)(frame->samples * 1000000ULL / SAMPLE_RATE);
+    frame->flags = 0;
+    
+    if (AEC_ENABLED) {
+      uint32_t start = ESP.getCycleCount();
+      echoCanceller.process(frame->data, frame->samples, frame->timestampUs);
+      aecCycles += ESP.getCycleCount() - start;
+    }
+    
+    // Apply gain
+    applyGainSat(frame->data, frame->samples, GAIN_Q8(MIC_GAIN));
+    
+    frame->speech = vadEnabled ? vad.process(frame->data, frame->samples) : true;
+    
+    captureRing.commit();
+  }
+}
+
+bool canEncode(AudioCodec codec) {
+  switch (codec) {
+    case CODEC_PCM16:
+    case CODEC_ADPCM:
+      return true;
+#if UMI_ENABLE_OPUS
+    case CODEC_OPUS:
+      return opusEncoder.ready();
+#endif
+    default:
+      return false;
+  }
+}
+
+// Per-session codec: PREFERRED_CODEC if both sides support it, else the default
+AudioCodec chooseSessionCodec() {
+  if (PREFERRED_CODEC[0] != '\0') {
+    AudioCodec preferred = codecFromName(PREFERRED_CODEC);
+    if (canEncode(preferred) && (bridgeCodecMask & (1 << preferred))) {
+      return preferred;
+    }
+    LOG_WARN("⚠️ Codec %s not available, using %s",
+             PREFERRED_CODEC, codecName(defaultCodec));
+  }
+  return defaultCodec;
+}
+
+// `packet` has RTP_HEADER_BYTES free in front of an audio message
+void sendRtpPacket(uint8_t* packet, size_t messageLen, bool marker, uint32_t timestampUs) {
+  RtpHeader rtp;
+  rtp.marker = marker;
+  rtp.sequence = rtpSequence++;
+  rtp.timestamp = timestampUs;
+  rtp.ssrc = rtpSsrc;
+  writeRtpHeader(rtp, packet);
   
-  for (int c = 0; c < chunks; c++) {
-    int offset = c * CHUNK_SIZE;
-    int chunkSize = min(CHUNK_SIZE, numSamples - offset);
+  rtpSocket.beginPacket(rtpBridgeIp, rtpBridgePort);
+  rtpSocket.write(packet, RTP_HEADER_BYTES + messageLen);
+  rtpSocket.endPacket();
+}
+
+// Downlink datagrams: one audio message each, same records as the WebSocket
+void receiveRtpAudio() {
+  int size;
+  while ((size = rtpSocket.parsePacket()) > 0) {
+    int length = rtpSocket.read(rtpPacket, sizeof(rtpPacket));
     
-    for (int i = 0; i < chunkSize; i++) {
-      int16_t sample = samples[offset + i];
-      stereoBuffer[i] = ((int32_t)sample << 16) | (sample & 0xFFFF);
+    RtpHeader rtp;
+    if (!rtpActive || length <= 0 || !readRtpHeader(rtp, rtpPacket, length) ||
+        rtp.ssrc != rtpBridgeSsrc) {
+      rtpForeign++;  // stale session, stray sender or not RTP: drained, dropped
+      continue;
+    }
+    handleDownlinkMessage(rtpPacket + RTP_HEADER_BYTES, length - RTP_HEADER_BYTES);
+  }
+}
+
+// `message` starts with FRAME_HEADROOM spare bytes followed by the payload.
+// The WebSockets library writes its header into the headroom and masks
+// the payload in place, so the buffer must not be sent twice.
+void sendAudioMessage(uint8_t* message, size_t payloadLen, uint32_t timestampUs, uint8_t flags) {
+  AudioFrameHeader header;
+  header.codec = uplinkCodec;
+  header.flags = flags | (uplinkMarker ? AUDIO_FLAG_MARKER : 0);
+  header.sequence = uplinkSequence++;
+  header.length = payloadLen;
+  header.timestampUs = timestampUs;
+  writeAudioHeader(header, message + WEBSOCKETS_MAX_HEADER_SIZE);
+  
+  if (rtpActive) {
+    sendRtpPacket(message + WEBSOCKETS_MAX_HEADER_SIZE - RTP_HEADER_BYTES,
+                  AUDIO_HEADER_BYTES + payloadLen, header.flags & AUDIO_FLAG_MARKER, timestampUs);
+    messagesSent++;
+    uplinkMarker = false;
+    return;
+  }
+  
+#if UPLINK_ZERO_COPY
+  webSocket.sendBIN(message, AUDIO_HEADER_BYTES + payloadLen, true);
+#else
+  // The library mallocs a frame and copies header + payload into it
+  webSocket.sendBIN(message + WEBSOCKETS_MAX_HEADER_SIZE, AUDIO_HEADER_BYTES + payloadLen);
+  uplinkBytesCopied += AUDIO_HEADER_BYTES + payloadLen;
+#endif
+  messagesSent++;
+  uplinkMarker = false;
+}
+
+// Encodes with the session codec into uplinkMessage and sends it
+void sendEncodedPcm(const int16_t* pcm, size_t samples, uint32_t timestampUs, uint8_t flags) {
+  size_t len;
+  
+  switch (uplinkCodec) {
+    case CODEC_ADPCM:
+      len = adpcmEncodeBlock(adpcmEncoder, pcm, samples, UPLINK_PAYLOAD);
+      break;
+      
+#if UMI_ENABLE_OPUS
+    case CODEC_OPUS:
+      // The first packet starts with samples buffered from earlier frames
+      timestampUs -= (uint32_t)(opusEncoder.pendingSamples() * 1000000ULL / SAMPLE_RATE);
+      len = opusEncoder.encode(pcm, samples, UPLINK_PAYLOAD, UPLINK_MAX_PAYLOAD);
+      // Nothing to send while a packet is still being filled
+      if (len == 0) return;
+      break;
+#endif
+      
+    default:
+      return;
+  }
+  
+  sendAudioMessage(uplinkMessage, len, timestampUs, flags);
+}
+
+int16_t* uplinkBatchBuffer() {
+  return uplinkCodec == CODEC_PCM16 ? (int16_t*)UPLINK_PAYLOAD : uplinkBatchPcm;
+}
+
+void flushUplinkBatch() {
+  if (uplinkBatchSamples == 0) return;
+  
+  if (uplinkCodec == CODEC_PCM16) {
+    sendAudioMessage(uplinkMessage, uplinkBatchSamples * sizeof(int16_t),
+                     uplinkBatchTimestampUs, uplinkBatchFlags);
+  } else {
+    sendEncodedPcm(uplinkBatchPcm, uplinkBatchSamples, uplinkBatchTimestampUs, uplinkBatchFlags);
+  }
+  uplinkBatchSamples = 0;
+  uplinkBatchFrames = 0;
+}
+
+void setUplinkBatching(uint32_t latencyMs) {
+  uint32_t frames = latencyMs / 30;
+  if (frames < 1) frames = 1;
+  if (frames > UPLINK_BATCH_MAX_FRAMES) frames = UPLINK_BATCH_MAX_FRAMES;
+  
+  // Never mix two batch sizes in one message
+  flushUplinkBatch();
+  uplinkBatchTarget = frames;
+  LOG_INFO("📦 Uplink batching: %u frames (%u ms)",
+           (unsigned)frames, (unsigned)(frames * 30));
+}
+
+void sendAudioFrame(AudioFrame* frame) {
+  uint32_t start = ESP.getCycleCount();
+  framesSent++;
+  
+  if (uplinkBatchTarget <= 1) {
+    if (uplinkCodec == CODEC_PCM16) {
+      // Raw PCM goes out straight from the ring slot's headroom
+      sendAudioMessage(frame->headroom, frame->samples * sizeof(int16_t),
+                       frame->timestampUs, frame->flags);
+    } else {
+      sendEncodedPcm(frame->data, frame->samples, frame->timestampUs, frame->flags);
+    }
+  } else {
+    // Pre-roll and live audio never share a message
+    if (uplinkBatchSamples > 0 && frame->flags != uplinkBatchFlags) {
+      flushUplinkBatch();
+    }
+    if (uplinkBatchSamples == 0) {
+      uplinkBatchTimestampUs = frame->timestampUs;
+      uplinkBatchFlags = frame->flags;
     }
+    memcpy(uplinkBatchBuffer() + uplinkBatchSamples, frame->data, frame->samples * sizeof(int16_t));
+    uplinkBytesCopied += frame->samples * sizeof(int16_t);
+    uplinkBatchSamples += frame->samples;
+    uplinkBatchFrames++;
     
+    if (uplinkBatchFrames >= uplinkBatchTarget) {
+      flushUplinkBatch();
+    }
+  }
+  
+  uplinkSendCycles += ESP.getCycleCount() - start;
+}
+
+// Tells the bridge how much silence was skipped so LiveKit still sees it
+void sendSilenceMarker() {
+  if (pendingSilenceSamples == 0) return;
+  
+  // Speech still waiting in a batch must reach the bridge first
+  flushUplinkBatch();
+  
+  if (rtpActive) {
+    // A control message on the WebSocket could overtake the datagrams
+    // before it; in-band the bridge orders it by sequence like the audio.
+    // The marker stays for the talkspurt that ends the silence.
+    bool marker = uplinkMarker;
+    uplinkMarker = false;
+    for (size_t i = 0; i < AUDIO_SILENCE_BYTES; i++) {
+      UPLINK_PAYLOAD[i] = (uint8_t)(pendingSilenceSamples >> (8 * i));
+    }
+    sendAudioMessage(uplinkMessage, AUDIO_SILENCE_BYTES, pendingSilenceUs, AUDIO_FLAG_SILENCE);
+    uplinkMarker = marker;
+  } else {
+    ControlMessage msg(CONTROL_SILENCE);
+    msg.setUint(CTRL_SAMPLES, pendingSilenceSamples);
+    sendControl(msg);
+  }
+  
+  pendingSilenceSamples = 0;
+}
+
+void suppressSilentFrame(const AudioFrame* frame) {
+  // End of speech: don't hold the tail back waiting for more frames
+  flushUplinkBatch();
+  uplinkMarker = true;
+  
+  // The oldest lookback frame is now definitely not needed for an onset
+  if (vadLookbackCount == VAD_LOOKBACK_FRAMES) {
+    AudioFrame* evicted = &vadLookback[vadLookbackHead];
+    if (pendingSilenceSamples == 0) pendingSilenceUs = evicted->timestampUs;
+    pendingSilenceSamples += evicted->samples;
+    framesSuppressed++;
+    vadLookbackCount--;
+    vadLookbackHead = (vadLookbackHead + 1) % VAD_LOOKBACK_FRAMES;
+  }
+  
+  uint8_t slot = (vadLookbackHead + vadLookbackCount) % VAD_LOOKBACK_FRAMES;
+  memcpy(&vadLookback[slot], frame, sizeof(AudioFrame));
+  vadLookbackCount++;
+  
+  if (pendingSilenceSamples >= SAMPLE_RATE * VAD_KEEPALIVE_MS / 1000) {
+    sendSilenceMarker();
+  }
+}
+
+void sendSpeechFrame(AudioFrame* frame) {
+  // Onset: close out the silence, then replay the lead-in frames
+  sendSilenceMarker();
+  while (vadLookbackCount > 0) {
+    sendAudioFrame(&vadLookback[vadLookbackHead]);
+    vadLookbackCount--;
+    vadLookbackHead = (vadLookbackHead + 1) % VAD_LOOKBACK_FRAMES;
+  }
+  
+  // Send to bridge (LiveKit VAD still runs on what gets through)
+  sendAudioFrame(frame);
+}
+
+void forwardFrame(AudioFrame* frame) {
+  if (frame->speech) {
+    sendSpeechFrame(frame);
+  } else {
+    suppressSilentFrame(frame);
+  }
+}
+
+AudioFrame* holdFrame(const AudioFrame* frame) {
+  AudioFrame* slot = pendingAudio.push();
+  if (slot) {
+    memcpy(slot, frame, sizeof(AudioFrame));
+  }
+  return slot;
+}
+
+void storePrerollFrame(const AudioFrame* frame) {
+  // While IDLE only the most recent PREROLL_MS is worth keeping
+  while (pendingAudio.size() >= PREROLL_FRAMES) {
+    pendingAudio.pop();
+  }
+  AudioFrame* slot = holdFrame(frame);
+  if (slot) {
+    slot->flags |= AUDIO_FLAG_PREROLL;
+  }
+}
+
+// Sends held audio oldest first: the pre-roll, then what arrived while STARTING
+void flushPendingAudio() {
+  size_t frames = pendingAudio.size();
+  uint32_t dropped = pendingAudio.evicted;
+  
+  AudioFrame* frame;
+  while ((frame = pendingAudio.front()) != NULL) {
+    forwardFrame(frame);
+    pendingAudio.pop();
+  }
+  pendingAudio.clear();
+  
+  if (frames > 0) {
+    LOG_INFO("⏪ Sent %u held frames (%u ms), %u dropped",
+             (unsigned)frames, (unsigned)(frames * 30), (unsigned)dropped);
+  }
+}
+
+// Runs in loop(): sends whatever the capture task has produced
+void sendCapturedAudio() {
+  AudioFrame* frame;
+  while ((frame = captureRing.peek()) != NULL) {
+    if (currentState == IN_SESSION || currentState == SPEAKING) {
+      forwardFrame(frame);
+    }
+    else if (currentState == STARTING) {
+      holdFrame(frame);
+    }
+    else if (currentState == IDLE) {
+      storePrerollFrame(frame);
+    }
+    // Frames captured just before other state changes are discarded
+    captureRing.release();
+  }
+}
+
+// Times the next reply from its first downlink byte to the DAC
+void armFirstAudioTimer() {
+  downlinkFirstByteUs = 0;
+  awaitingFirstAudio = true;
+}
+
+// Runs at high priority: jitterBuffer -> I2S DMA, so the WebSocket
+// callback only ever enqueues. The speaker channel is always running and
+// silence is never queued ahead of a reply, so once the jitter buffer
+// reaches its target the first block goes straight into an idle DMA.
+void playbackTask(void* arg) {
+  int16_t block[PLAYBACK_BLOCK];
+  
+  for (;;) {
+    if (!jitterBuffer.active()) {
+      // Agent finished and everything was played: listen again
+      if (isSpeakerMode && currentState != SPEAKING) {
+        isSpeakerMode = false;
+      }
+      // Woken by handleDownlinkMessage as soon as audio arrives
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5));
+      continue;
+    }
+    
+    isSpeakerMode = true;
+    
+    size_t buffered = jitterBuffer.read(block, PLAYBACK_BLOCK);
+    
+    // Blocks until the DMA has room, which paces the jitter buffer reads
     size_t written;
-    i2s_write(I2S_NUM_0, stereoBuffer, chunkSize * sizeof(int32_t), &written, portMAX_DELAY);
+    i2s_channel_write(speakerChannel, block, sizeof(block), &written, 100);
+    
+    if (awaitingFirstAudio && buffered > 0 && downlinkFirstByteUs != 0) {
+      awaitingFirstAudio = false;
+      uint32_t now = (uint32_t)esp_timer_get_time();
+      if (speechEndUs != 0) {
+        LOG_INFO("⏱️ Reply audio: first byte -> DAC %u ms, %u ms after end of speech",
+                 (unsigned)((now - downlinkFirstByteUs) / 1000),
+                 (unsigned)((now - speechEndUs) / 1000));
+        speechEndUs = 0;
+      } else {
+        LOG_INFO("⏱️ Reply audio: first byte -> DAC %u ms",
+                 (unsigned)((now - downlinkFirstByteUs) / 1000));
+      }
+    }
+    
+    // The block now sits at the back of a full DMA queue
+    if (AEC_ENABLED) {
+      uint32_t playoutUs = (uint32_t)esp_timer_get_time() + SPEAKER_QUEUE_US -
+                           PLAYBACK_BLOCK * 1000000ULL / SAMPLE_RATE;
+      echoCanceller.pushReference(block, PLAYBACK_BLOCK, playoutUs);
+    }
+  }
+}
+
+// Converts from the stream's declared rate on the way into the jitter buffer
+void queuePlayback(const int16_t* pcm, size_t samples) {
+  int16_t out[Resampler::MAX_INPUT + 1];
+  while (samples > 0) {
+    size_t take = min(samples, (size_t)Resampler::MAX_INPUT);
+    jitterBuffer.write(out, downlinkResampler.process(pcm, take, out));
+    pcm += take;
+    samples -= take;
+  }
+}
+
+// Called from the WebSocket callback: decode and enqueue only
+void playAudioPayload(AudioCodec codec, const uint8_t* data, size_t length) {
+  if (codec == CODEC_ADPCM) {
+    AdpcmState state;
+    if (!adpcmReadHeader(state, data, length)) return;
+    data += ADPCM_HEADER_BYTES;
+    length -= ADPCM_HEADER_BYTES;
+    
+    // Decode a chunk at a time so the stack buffer stays small
+    int16_t pcm[CHUNK_SIZE];
+    while (length > 0) {
+      size_t bytes = min((size_t)(CHUNK_SIZE / 2), length);
+      size_t samples = adpcmDecode(state, data, bytes, pcm);
+      queuePlayback(pcm, samples);
+      data += bytes;
+      length -= bytes;
+    }
+    return;
+  }
+  
+#if UMI_ENABLE_OPUS
+  if (codec == CODEC_OPUS) {
+    // [u16 LE length][packet] records, each decoded at the playback rate
+    int16_t pcm[OpusDownlinkDecoder::MAX_FRAME_SAMPLES];
+    while (length >= 2) {
+      size_t packetLength = data[0] | (data[1] << 8);
+      data += 2;
+      length -= 2;
+      if (packetLength > length) {
+        downlinkMalformed++;
+        return;
+      }
+      size_t samples = opusDecoder.decode(data, packetLength, pcm, OpusDownlinkDecoder::MAX_FRAME_SAMPLES);
+      jitterBuffer.write(pcm, samples);
+      data += packetLength;
+      length -= packetLength;
+    }
+    return;
+  }
+#endif
+  
+  if (codec == CODEC_PCM16) {
+    queuePlayback((const int16_t*)data, length / 2);
+  }
+}
+
+// Returns false for frames that arrive after a newer one (too late to play)
+bool trackDownlinkFrame(const AudioFrameHeader& header) {
+  if (downlinkSeqValid) {
+    int16_t delta = (int16_t)(header.sequence - downlinkExpectedSeq);
+    if (delta < 0) {
+      downlinkLate++;
+      return false;
+    }
+    downlinkLost += delta;
+  }
+  downlinkExpectedSeq = header.sequence + 1;
+  
+  // Interarrival jitter: clocks differ, only the change in transit time matters
+  int32_t transit = (int32_t)((uint32_t)esp_timer_get_time() - header.timestampUs);
+  if (downlinkSeqValid) {
+    int32_t d = transit - downlinkLastTransitUs;
+    if (d < 0) d = -d;
+    downlinkJitterUs += ((int32_t)d - (int32_t)downlinkJitterUs) / 16;
+  }
+  downlinkLastTransitUs = transit;
+  downlinkSeqValid = true;
+  jitterBuffer.updateJitter(downlinkJitterUs);
+  return true;
+}
+
+// Keeps a record that arrived before agent_speaking_start
+void holdEarlyDownlink(const uint8_t* record, size_t length) {
+  if (!earlyDownlink || earlyDownlinkLength + length > EARLY_DOWNLINK_BYTES) {
+    earlyDownlinkDropped++;
+    return;
+  }
+  if (earlyDownlinkLength == 0) {
+    earlyDownlinkSinceMs = millis();
+  }
+  memcpy(earlyDownlink + earlyDownlinkLength, record, length);
+  earlyDownlinkLength += length;
+}
+
+void flushEarlyDownlink() {
+  if (earlyDownlinkLength == 0) return;
+  
+  LOG_INFO("⏪ Playing %u bytes of early TTS audio (%u records did not fit)",
+           (unsigned)earlyDownlinkLength, (unsigned)earlyDownlinkDropped);
+  const uint8_t* data = earlyDownlink;
+  size_t length = earlyDownlinkLength;
+  AudioFrameHeader header;
+  while (readAudioHeader(header, data, length)) {
+    playAudioPayload((AudioCodec)header.codec, data + AUDIO_HEADER_BYTES, header.length);
+    data += AUDIO_HEADER_BYTES + header.length;
+    length -= AUDIO_HEADER_BYTES + header.length;
+  }
+  earlyDownlinkLength = 0;
+  earlyDownlinkDropped = 0;
+  
+  // Usually a whole prebuffer's worth: start now, not on the next 5 ms poll
+  if (playbackTaskHandle) xTaskNotifyGive(playbackTaskHandle);
+}
+
+void discardEarlyDownlink() {
+  if (earlyDownlinkLength > 0) {
+    LOG_INFO("🗑️ Discarding %u bytes of early TTS audio", (unsigned)earlyDownlinkLength);
+  }
+  earlyDownlinkLength = 0;
+  earlyDownlinkDropped = 0;
+}
+
+void noteDownlinkArrival() {
+  bool replying = currentState == SPEAKING || currentState == IN_SESSION;
+  if (awaitingFirstAudio && downlinkFirstByteUs == 0 && replying) {
+    downlinkFirstByteUs = (uint32_t)esp_timer_get_time();
+  }
+}
+
+// One complete [header][payload] record
+void handleDownlinkRecord(const AudioFrameHeader& header, const uint8_t* record) {
+  if (!trackDownlinkFrame(header)) return;
+  
+  if (currentState == SPEAKING) {
+    playAudioPayload((AudioCodec)header.codec, record + AUDIO_HEADER_BYTES, header.length);
+  }
+  else if (currentState == IN_SESSION) {
+    holdEarlyDownlink(record, AUDIO_HEADER_BYTES + header.length);
+  }
+}
+
+void handleDownlinkMessage(const uint8_t* data, size_t length) {
+  noteDownlinkArrival();
+  
+  while (length > 0) {
+    AudioFrameHeader header;
+    if (!readAudioHeader(header, data, length)) {
+      downlinkMalformed++;
+      return;
+    }
+    
+    handleDownlinkRecord(header, data);
+    data += AUDIO_HEADER_BYTES + header.length;
+    length -= AUDIO_HEADER_BYTES + header.length;
+  }
+  
+  if (playbackTaskHandle) xTaskNotifyGive(playbackTaskHandle);
+}
+
+// Streamed PCM16 payload bytes; an odd trailing byte waits for its pair
+void streamPcmBytes(const uint8_t* data, size_t length) {
+  int16_t pcm[Resampler::MAX_INPUT];
+  uint8_t* bytes = (uint8_t*)pcm;
+  
+  while (length > 0) {
+    size_t fill = 0;
+    if (downlinkRecordFill > AUDIO_HEADER_BYTES) {
+      bytes[fill++] = downlinkRecord[AUDIO_HEADER_BYTES];
+      downlinkRecordFill = AUDIO_HEADER_BYTES;
+    }
+    size_t take = min(length, sizeof(pcm) - fill);
+    memcpy(bytes + fill, data, take);
+    fill += take;
+    data += take;
+    length -= take;
+    
+    if (fill & 1) {
+      downlinkRecord[downlinkRecordFill++] = bytes[--fill];
+    }
+    queuePlayback(pcm, fill / 2);
+  }
+}
+
+// Streamed ADPCM payload bytes: the 4-byte block header, then nibbles
+void streamAdpcmBytes(const uint8_t* data, size_t length) {
+  while (length > 0 && downlinkRecordFill < AUDIO_HEADER_BYTES + ADPCM_HEADER_BYTES) {
+    downlinkRecord[downlinkRecordFill++] = *data++;
+    length--;
+    if (downlinkRecordFill == AUDIO_HEADER_BYTES + ADPCM_HEADER_BYTES &&
+        !adpcmReadHeader(downlinkAdpcm, downlinkRecord + AUDIO_HEADER_BYTES, ADPCM_HEADER_BYTES)) {
+      downlinkRecordMode = RECORD_DROP;
+      return;
+    }
+  }
+  
+  int16_t pcm[CHUNK_SIZE];
+  while (length > 0) {
+    size_t bytes = min((size_t)(CHUNK_SIZE / 2), length);
+    size_t samples = adpcmDecode(downlinkAdpcm, data, bytes, pcm);
+    queuePlayback(pcm, samples);
+    data += bytes;
+    length -= bytes;
+  }
+}
+
+// Header complete: PCM / ADPCM being played stream straight through,
+// anything else is collected until the record is whole
+void beginDownlinkRecord() {
+  AudioFrameHeader& header = downlinkRecordHeader;
+  downlinkRecordLeft = header.length;
+  
+  bool streamable = currentState == SPEAKING &&
+                    (header.codec == CODEC_PCM16 || header.codec == CODEC_ADPCM);
+  if (streamable) {
+    if (!trackDownlinkFrame(header)) {
+      downlinkRecordMode = RECORD_DROP;
+    } else {
+      downlinkRecordMode = header.codec == CODEC_PCM16 ? RECORD_STREAM_PCM : RECORD_STREAM_ADPCM;
+    }
+  }
+  else if (AUDIO_HEADER_BYTES + header.length <= DOWNLINK_RECORD_BYTES) {
+    downlinkRecordMode = RECORD_COLLECT;
+  }
+  else {
+    downlinkMalformed++;
+    downlinkRecordMode = RECORD_DROP;
+  }
+}
+
+void endDownlinkRecord() {
+  if (downlinkRecordMode == RECORD_COLLECT) {
+    handleDownlinkRecord(downlinkRecordHeader, downlinkRecord);
+  }
+  downlinkRecordFill = 0;
+  downlinkRecordMode = RECORD_DROP;
+}
+
+// Parses a fragmented message as it arrives; records may straddle fragments
+void handleDownlinkFragment(const uint8_t* data, size_t length, bool first, bool last) {
+  if (first) {
+    noteDownlinkArrival();
+    downlinkFragmented = true;
+    downlinkRecordFill = 0;
+    downlinkRecordMode = RECORD_DROP;
+  }
+  
+  while (length > 0) {
+    if (downlinkRecordFill < AUDIO_HEADER_BYTES) {
+      size_t take = min(length, AUDIO_HEADER_BYTES - downlinkRecordFill);
+      memcpy(downlinkRecord + downlinkRecordFill, data, take);
+      downlinkRecordFill += take;
+      data += take;
+      length -= take;
+      if (downlinkRecordFill < AUDIO_HEADER_BYTES) break;
+      
+      if (!parseAudioHeader(downlinkRecordHeader, downlinkRecord)) {
+        // Lost framing; nothing else in this message can be trusted
+        downlinkMalformed++;
+        downlinkFragmented = false;
+        downlinkRecordFill = 0;
+        return;
+      }
+      beginDownlinkRecord();
+      if (downlinkRecordLeft == 0) endDownlinkRecord();
+      continue;
+    }
+    
+    size_t take = min(length, downlinkRecordLeft);
+    switch (downlinkRecordMode) {
+      case RECORD_STREAM_PCM:
+        streamPcmBytes(data, take);
+        break;
+      case RECORD_STREAM_ADPCM:
+        streamAdpcmBytes(data, take);
+        break;
+      case RECORD_COLLECT:
+        memcpy(downlinkRecord + downlinkRecordFill, data, take);
+        downlinkRecordFill += take;
+        break;
+      case RECORD_DROP:
+        break;
+    }
+    data += take;
+    length -= take;
+    downlinkRecordLeft -= take;
+    if (downlinkRecordLeft == 0) endDownlinkRecord();
+  }
+  
+  if (last) {
+    if (downlinkRecordFill != 0) {
+      downlinkMalformed++;  // message ended inside a record
+      downlinkRecordFill = 0;
+    }
+    downlinkFragmented = false;
   }
+  
+  if (playbackTaskHandle) xTaskNotifyGive(playbackTaskHandle);
 }
 
 /* ==================== SESSION MANAGEMENT ==================== */
 
+// The bridge is ready (or we gave up waiting): send what was held, then go live
+void beginStreaming() {
+  // Frames still in the capture ring belong to the held audio too
+  sendCapturedAudio();
+  
+  currentState = IN_SESSION;
+  flushPendingAudio();
+}
+
 void startNewSession() {
   if (currentState != IDLE) {
-    Serial.println("⚠️ Already in session or not connected");
+    LOG_WARN("⚠️ Already in session or not connected");
     return;
   }
   
+  // Everything captured so far belongs to the pre-roll
+  sendCapturedAudio();
+  
   // Generate session ID
-  currentSessionId = "session-" + String(millis());
-  currentState = IN_SESSION;
+  snprintf(currentSessionId, sizeof(currentSessionId), "session-%u", (unsigned)millis());
+  sessionStartPending = true;
+  framesCaptured = 0;
+  framesDropped = 0;
+  framesSent = 0;
+  messagesSent = 0;
+  uplinkBytesCopied = 0;
+  uplinkSendCycles = 0;
+  framesSuppressed = 0;
+  pendingSilenceSamples = 0;
+  vadLookbackCount = 0;
+  uplinkBatchSamples = 0;
+  uplinkBatchFrames = 0;
   
-  Serial.printf("🆕 Starting new session: %s\n", currentSessionId.c_str());
+  uplinkCodec = chooseSessionCodec();
+  uplinkMarker = true;
+  downlinkLost = 0;
+  downlinkLate = 0;
+  downlinkMalformed = 0;
+  adpcmEncoder = AdpcmState();
+#if UMI_ENABLE_OPUS
+  opusEncoder.reset();
+#endif
+  pendingAudio.evicted = 0;
+  echoCanceller.reset();
+  aecCycles = 0;
+  sessionStartMs = millis();
+  currentState = STARTING;
   
-  // Make sure we're in mic mode
-  if (isSpeakerMode) {
-    setupI2SMic();
-  }
+  LOG_INFO("🆕 Starting new session: %s (%s)",
+           currentSessionId, codecName(uplinkCodec));
   
   // Send session start to bridge
-  StaticJsonDocument<200> doc;
-  doc["type"] = "start_session";
-  doc["session_id"] = currentSessionId;
-  
-  String json;
-  serializeJson(doc, json);
-  webSocket.sendTXT(json);
+  ControlMessage msg(CONTROL_START_SESSION);
+  msg.setString(CTRL_SESSION_ID, currentSessionId);
+  msg.setUint(CTRL_CODEC, uplinkCodec);
+  sendControl(msg);
   
+  // Audio is held until session_started; see beginStreaming()
   digitalWrite(LED_PIN, HIGH);
 }
 
 void endSession() {
-  if (currentState != IN_SESSION && currentState != SPEAKING) {
-    Serial.println("⚠️ Not in session");
+  if (currentState != STARTING && currentState != IN_SESSION && currentState != SPEAKING) {
+    LOG_WARN("⚠️ Not in session");
     return;
   }
   
-  Serial.println("✅ Ending session");
+  LOG_INFO("✅ Ending session");
+  
+  flushUplinkBatch();
+  
+  LOG_INFO("📊 Frames: %u captured, %u sent in %u messages, %u dropped",
+           (unsigned)framesCaptured, (unsigned)framesSent,
+           (unsigned)messagesSent, (unsigned)framesDropped);
+  if (framesSent > 0) {
+    LOG_INFO("📤 Uplink per frame: %u bytes copied, %u cycles",
+             (unsigned)(uplinkBytesCopied / framesSent),
+             (unsigned)(uplinkSendCycles / framesSent));
+  }
+  if (echoCanceller.farEndFrames > 0) {
+    LOG_INFO("🔁 AEC: ERLE %.1f dB over %u frames, %u double talk, %u cycles/frame",
+             echoCanceller.erleDb(), (unsigned)echoCanceller.farEndFrames,
+             (unsigned)echoCanceller.doubleTalkFrames,
+             (unsigned)(aecCycles / (framesCaptured ? framesCaptured : 1)));
+  }
+  if (framesCaptured > 0) {
+    LOG_INFO("🔇 VAD: %u frames suppressed (%u%% of uplink saved)",
+             (unsigned)framesSuppressed,
+             (unsigned)(framesSuppressed * 100 / framesCaptured));
+  }
+  
+  if (rtpForeign > 0) {
+    LOG_INFO("📡 RTP: %u stray datagrams dropped", (unsigned)rtpForeign);
+    rtpForeign = 0;
+  }
+  
+  // Fragmentation shows as the largest block falling behind free space
+  // over many sessions; the low-water mark is since boot
+  size_t heapFree = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  size_t heapLargest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  LOG_INFO("🧠 Heap: %u free, largest block %u (%u%% fragmented), low water %u",
+           (unsigned)heapFree, (unsigned)heapLargest,
+           (unsigned)(heapFree ? 100 - heapLargest * 100 / heapFree : 0),
+           (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
   
   // Send session end to bridge
-  StaticJsonDocument<200> doc;
-  doc["type"] = "end_session";
-  doc["session_id"] = currentSessionId;
+  ControlMessage msg(CONTROL_END_SESSION);
+  msg.setString(CTRL_SESSION_ID, currentSessionId);
+  msg.setUint(CTRL_FRAMES_CAPTURED, framesCaptured);
+  msg.setUint(CTRL_FRAMES_DROPPED, framesDropped);
+  msg.setUint(CTRL_FRAMES_SUPPRESSED, framesSuppressed);
+  sendControl(msg);
+  
+  // Start the next pre-roll from fresh audio only
+  pendingAudio.clear();
+  discardEarlyDownlink();
   
-  String json;
-  serializeJson(doc, json);
-  webSocket.sendTXT(json);
+  // Cut the agent off; playbackTask then unmutes the mic
+  jitterBuffer.reset();
+  rtpActive = false;
   
-  currentSessionId = "";
+  currentSessionId[0] = '\0';
+  sessionStartPending = false;
   currentState = IDLE;
   digitalWrite(LED_PIN, LOW);
-  
-  // Switch back to mic mode if needed
-  if (isSpeakerMode) {
-    setupI2SMic();
-  }
 }
 
 /* ==================== BUTTON HANDLING ==================== */
@@ -336,7 +1521,7 @@ void handleButton() {
         // Start new chat session
         startNewSession();
       }
-      else if (currentState == IN_SESSION || currentState == SPEAKING) {
+      else if (currentState == STARTING || currentState == IN_SESSION || currentState == SPEAKING) {
         // End current session
         endSession();
       }
@@ -347,13 +1532,14 @@ void handleButton() {
   
   // Long press = deep sleep
   if (btn == LOW && !longPressHandled && (now - pressStart) >= 3000) {
-    Serial.println("😴 Long press - sleep mode");
+    LOG_INFO("😴 Long press - sleep mode");
     longPressHandled = true;
     
-    if (currentState == IN_SESSION) {
+    if (currentState == STARTING || currentState == IN_SESSION || currentState == SPEAKING) {
       endSession();
     }
     
+    asyncLog.flush(500);
     delay(100);
     esp_deep_sleep_start();
   }
@@ -362,7 +1548,7 @@ void handleButton() {
 /* ==================== WIFI SETUP ==================== */
 
 void setupWiFi() {
-  Serial.printf("📡 Connecting to %s...\n", WIFI_SSID);
+  LOG_INFO("📡 Connecting to %s...", WIFI_SSID);
   
   WiFi.mode(WIFI_STA);
   WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
@@ -370,27 +1556,31 @@ void setupWiFi() {
   int attempts = 0;
   while (WiFi.status() != WL_CONNECTED && attempts < 30) {
     delay(500);
-    Serial.print(".");
+    Serial.print(".");  // progress dots only, straight to the UART
     attempts++;
   }
   
   if (WiFi.status() == WL_CONNECTED) {
-    Serial.printf("\n✅ WiFi connected\n");
-    Serial.printf("📍 IP: %s\n", WiFi.localIP().toString().c_str());
+    LOG_INFO("\n✅ WiFi connected");
+    LOG_INFO("📍 IP: %s", WiFi.localIP().toString().c_str());
   } else {
-    Serial.println("\n❌ WiFi failed!");
+    LOG_ERROR("\n❌ WiFi failed!");
   }
 }
 
 /* ==================== MAIN ==================== */
 
+// Unit test builds (pio test) bring their own setup() and loop()
+#ifndef PIO_UNIT_TESTING
+
 void setup() {
   Serial.begin(115200);
   delay(1000);
+  asyncLog.begin(LOG_TASK_CORE, LOG_TASK_PRIORITY);
   
-  Serial.println("\n╔═══════════════════════════════╗");
-  Serial.println("║  UMI - LiveKit VAD Edition    ║");
-  Serial.println("╚═══════════════════════════════╝\n");
+  LOG_INFO("\n╔═══════════════════════════════╗");
+  LOG_INFO("║  UMI - LiveKit VAD Edition    ║");
+  LOG_INFO("╚═══════════════════════════════╝\n");
   
   pinMode(BUTTON_PIN, INPUT_PULLUP);
   pinMode(LED_PIN, OUTPUT);
@@ -399,32 +1589,78 @@ void setup() {
   setupWiFi();
   
   if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("❌ FATAL: No WiFi");
+    LOG_ERROR("❌ FATAL: No WiFi");
     while(1) delay(1000);
   }
   
+#if UMI_ENABLE_OPUS
+  opusEncoder.begin(SAMPLE_RATE, OPUS_FRAME_MS, OPUS_BITRATE, OPUS_COMPLEXITY, OPUS_DTX);
+  opusDecoder.begin(SAMPLE_RATE);
+#endif
+  
+  VadConfig vadConfig = VAD_DEFAULT_CONFIG;
+  vad.begin(vadConfig);
+  
+  if (!pendingAudio.begin(PREROLL_FRAMES + SESSION_START_BUFFER_FRAMES)) {
+    LOG_WARN("⚠️ No memory for pre-roll / session start buffer");
+  }
+  
+  earlyDownlink = (uint8_t*)ps_malloc(EARLY_DOWNLINK_BYTES);
+  if (!earlyDownlink) {
+    earlyDownlink = (uint8_t*)malloc(EARLY_DOWNLINK_BYTES);
+  }
+  
+  if (!jitterBuffer.begin(SAMPLE_RATE, JITTER_MIN_MS, JITTER_MAX_MS)) {
+    LOG_WARN("⚠️ No memory for jitter buffer");
+  }
+  if (AEC_ENABLED && !echoCanceller.begin(SAMPLE_RATE, AEC_STEP_Q15)) {
+    LOG_WARN("⚠️ No memory for echo canceller");
+  }
+  
   setupI2SMic();
+  setupI2SSpeaker();
+  
+  xTaskCreatePinnedToCore(captureTask, "capture", CAPTURE_TASK_STACK, NULL,
+                          CAPTURE_TASK_PRIORITY, NULL, CAPTURE_TASK_CORE);
+  xTaskCreatePinnedToCore(playbackTask, "playback", PLAYBACK_TASK_STACK, NULL,
+                          PLAYBACK_TASK_PRIORITY, &playbackTaskHandle, PLAYBACK_TASK_CORE);
+  
+  if (RTP_ENABLED) {
+    rtpSsrc = esp_random();
+    rtpSocket.begin(RTP_LOCAL_PORT);
+  }
   
-  Serial.printf("🌉 Connecting to bridge at %s:%d\n", BRIDGE_HOST, BRIDGE_PORT);
+  LOG_INFO("🌉 Connecting to bridge at %s:%d", BRIDGE_HOST, BRIDGE_PORT);
   webSocket.begin(BRIDGE_HOST, BRIDGE_PORT, "/");
   webSocket.onEvent(webSocketEvent);
   webSocket.setReconnectInterval(5000);
   
-  Serial.println("\n✅ Ready!");
-  Serial.println("🔘 Press button = Start new chat");
-  Serial.println("🔘 Press again = End chat");
-  Serial.println("⏸️ Hold 3s = Sleep\n");
+  LOG_INFO("\n✅ Ready!");
+  LOG_INFO("🔘 Press button = Start new chat");
+  LOG_INFO("🔘 Press again = End chat");
+  LOG_INFO("⏸️ Hold 3s = Sleep\n");
 }
 
 void loop() {
   webSocket.loop();
+  if (RTP_ENABLED) receiveRtpAudio();
   handleButton();
   
-  // Continuous audio streaming when in session
-  if (currentState == IN_SESSION && !isSpeakerMode) {
-    streamAudioChunk();
+  // Bridge never confirmed the session: fall back to streaming blind
+  if (currentState == STARTING && millis() - sessionStartMs >= SESSION_START_TIMEOUT_MS) {
+    LOG_WARN("⚠️ No session_started from bridge, streaming anyway");
+    beginStreaming();
   }
-  else {
-    delay(10);
+  
+  // Audio that arrived early but no reply followed: stale by now
+  if (earlyDownlinkLength > 0 && currentState == IN_SESSION &&
+      millis() - earlyDownlinkSinceMs >= EARLY_DOWNLINK_TIMEOUT_MS) {
+    discardEarlyDownlink();
   }
-}
\ No newline at end of file
+  
+  // Capture runs in its own task; just forward what it produced
+  sendCapturedAudio();
+  delay(5);
+}
+
+#endif  // PIO_UNIT_TESTING
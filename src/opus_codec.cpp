@@ -0,0 +1,124 @@
+#include "opus_codec.h"
+
+#if UMI_ENABLE_OPUS
+
+#include <Arduino.h>
+#include "async_log.h"
+
+bool OpusUplinkEncoder::begin(int sampleRate, int frameMs, int bitrate, int complexity, bool dtx) {
+  end();
+
+  frameSamples_ = (size_t)sampleRate * frameMs / 1000;
+  if (frameSamples_ == 0 || frameSamples_ > MAX_FRAME_SAMPLES) {
+    LOG_ERROR("❌ Opus: unsupported frame size %d ms", frameMs);
+    return false;
+  }
+
+  int err = OPUS_OK;
+  encoder_ = opus_encoder_create(sampleRate, 1, OPUS_APPLICATION_VOIP, &err);
+  if (err != OPUS_OK || encoder_ == NULL) {
+    LOG_ERROR("❌ Opus: encoder init failed (%s)", opus_strerror(err));
+    encoder_ = NULL;
+    return false;
+  }
+
+  opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(bitrate));
+  opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(complexity));
+  opus_encoder_ctl(encoder_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+  opus_encoder_ctl(encoder_, OPUS_SET_DTX(dtx ? 1 : 0));
+
+  reset();
+  return true;
+}
+
+void OpusUplinkEncoder::end() {
+  if (encoder_) {
+    opus_encoder_destroy(encoder_);
+    encoder_ = NULL;
+  }
+}
+
+void OpusUplinkEncoder::reset() {
+  if (encoder_) opus_encoder_ctl(encoder_, OPUS_RESET_STATE);
+  pendingCount_ = 0;
+  packets = 0;
+  dtxPackets = 0;
+}
+
+size_t OpusUplinkEncoder::encode(const int16_t* pcm, size_t samples, uint8_t* out, size_t capacity) {
+  if (!encoder_) return 0;
+
+  size_t written = 0;
+  while (samples > 0) {
+    size_t take = frameSamples_ - pendingCount_;
+    if (take > samples) take = samples;
+    memcpy(pending_ + pendingCount_, pcm, take * sizeof(int16_t));
+    pendingCount_ += take;
+    pcm += take;
+    samples -= take;
+
+    if (pendingCount_ < frameSamples_) break;
+    pendingCount_ = 0;
+
+    if (capacity - written < 2 + MAX_PACKET_BYTES) {
+      // Caller's buffer is too small; the packet is lost rather than truncated
+      continue;
+    }
+
+    opus_int32 len = opus_encode(encoder_, pending_, (int)frameSamples_,
+                                 out + written + 2, MAX_PACKET_BYTES);
+    if (len < 0) {
+      LOG_ERROR("❌ Opus: encode failed (%s)", opus_strerror(len));
+      continue;
+    }
+    packets++;
+    if (len <= 2) dtxPackets++;
+
+    out[written] = (uint8_t)(len & 0xFF);
+    out[written + 1] = (uint8_t)(len >> 8);
+    written += 2 + len;
+  }
+  return written;
+}
+
+bool OpusDownlinkDecoder::begin(int sampleRate) {
+  end();
+
+  int err = OPUS_OK;
+  decoder_ = opus_decoder_create(sampleRate, 1, &err);
+  if (err != OPUS_OK || decoder_ == NULL) {
+    LOG_ERROR("❌ Opus: decoder init failed (%s)", opus_strerror(err));
+    decoder_ = NULL;
+    return false;
+  }
+
+  reset();
+  return true;
+}
+
+void OpusDownlinkDecoder::end() {
+  if (decoder_) {
+    opus_decoder_destroy(decoder_);
+    decoder_ = NULL;
+  }
+}
+
+void OpusDownlinkDecoder::reset() {
+  if (decoder_) opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+  packets = 0;
+  errors = 0;
+}
+
+size_t OpusDownlinkDecoder::decode(const uint8_t* packet, size_t length, int16_t* out, size_t capacity) {
+  if (!decoder_) return 0;
+
+  int samples = opus_decode(decoder_, packet, (opus_int32)length, out, (int)capacity, 0);
+  if (samples < 0) {
+    errors++;
+    return 0;
+  }
+  packets++;
+  return (size_t)samples;
+}
+
+#endif  // UMI_ENABLE_OPUS
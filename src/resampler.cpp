@@ -0,0 +1,130 @@
+#include "resampler.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Taps per phase = this x M / L; 24 puts the 48k transition band at ~3.5 kHz
+#define RESAMPLER_TAPS_PER_RATIO 24
+#define RESAMPLER_MAX_TAPS 96
+// L, and so the table's rows; 320 is 22.05k -> 16k. Odd declared rates
+// (47999 Hz: L = 16000) would otherwise build megabytes of taps in the
+// WebSocket callback
+#define RESAMPLER_MAX_PHASES 320
+// Passband edge relative to the output Nyquist, leaving room for the transition
+#define RESAMPLER_CUTOFF 0.9f
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+Resampler::~Resampler() {
+  release();
+}
+
+void Resampler::release() {
+  free(coeffs_);
+  free(history_);
+  coeffs_ = nullptr;
+  history_ = nullptr;
+}
+
+bool Resampler::begin(uint32_t inputRate, uint32_t outputRate) {
+  if (inputRate == inputRate_ && !passthrough()) {
+    reset();
+    return true;
+  }
+  release();
+  inputRate_ = inputRate;
+  if (inputRate == 0 || inputRate == outputRate) return inputRate != 0;
+
+  uint32_t g = gcd(inputRate, outputRate);
+  up_ = outputRate / g;
+  down_ = inputRate / g;
+  if (up_ > down_) return false;   // only ever needed for downsampling
+  if (up_ > RESAMPLER_MAX_PHASES) return false;
+
+  taps_ = RESAMPLER_TAPS_PER_RATIO * down_ / up_;
+  if (taps_ > RESAMPLER_MAX_TAPS) return false;
+  size_t length = taps_ * up_;
+  coeffs_ = (int16_t*)malloc(length * sizeof(int16_t));
+  history_ = (int16_t*)calloc(taps_ - 1 + MAX_INPUT, sizeof(int16_t));
+  if (!coeffs_ || !history_) {
+    release();
+    return false;
+  }
+
+  // Windowed sinc at the upsampled rate, cut off below the output Nyquist
+  float fc = RESAMPLER_CUTOFF / down_;
+  float center = (length - 1) / 2.0f;
+  for (uint32_t p = 0; p < up_; p++) {
+    float h[RESAMPLER_MAX_TAPS];
+    float sum = 0;
+    for (size_t k = 0; k < taps_; k++) {
+      size_t n = k * up_ + p;
+      float t = n - center;
+      float sinc = t == 0 ? 1.0f : sinf((float)M_PI * fc * t) / ((float)M_PI * fc * t);
+      float w = 0.42f - 0.5f * cosf(2 * (float)M_PI * n / (length - 1)) +
+                0.08f * cosf(4 * (float)M_PI * n / (length - 1));
+      h[k] = sinc * w;
+      sum += h[k];
+    }
+    // Each phase passes DC at unity, so there is no ripple at the phase rate
+    for (size_t k = 0; k < taps_; k++) {
+      coeffs_[p * taps_ + k] = (int16_t)lrintf(h[k] / sum * 32767.0f);
+    }
+  }
+
+  reset();
+  return true;
+}
+
+void Resampler::reset() {
+  phase_ = 0;
+  skip_ = 0;
+  if (history_) memset(history_, 0, (taps_ - 1) * sizeof(int16_t));
+}
+
+size_t Resampler::process(const int16_t* in, size_t samples, int16_t* out) {
+  if (passthrough()) {
+    memmove(out, in, samples * sizeof(int16_t));
+    return samples;
+  }
+
+  size_t written = 0;
+  while (samples > 0) {
+    size_t block = samples < MAX_INPUT ? samples : MAX_INPUT;
+    int16_t* x = history_ + taps_ - 1;   // x[i] is input i of this block
+    memcpy(x, in, block * sizeof(int16_t));
+
+    // Output sits phase_/L of the way past input i; tap k weighs input i - k
+    size_t i = skip_;
+    while (i < block) {
+      const int16_t* h = coeffs_ + phase_ * taps_;
+      int32_t acc = 1 << 14;
+      for (size_t k = 0; k < taps_; k++) {
+        acc += (int32_t)h[k] * x[(int32_t)i - (int32_t)k];
+      }
+      acc >>= 15;
+      if (acc > 32767) acc = 32767;
+      if (acc < -32768) acc = -32768;
+      out[written++] = (int16_t)acc;
+
+      phase_ += down_;
+      i += phase_ / up_;
+      phase_ %= up_;
+    }
+
+    // Carry the overshoot into the next block and keep the history
+    memmove(history_, x + block - (taps_ - 1), (taps_ - 1) * sizeof(int16_t));
+    skip_ = i - block;
+    in += block;
+    samples -= block;
+  }
+  return written;
+}
@@ -0,0 +1,75 @@
+#include "vad.h"
+
+// Floor never drops below this so a digitally silent mic still has a margin
+#define VAD_NOISE_FLOOR_MIN 100
+
+void Vad::begin(const VadConfig& cfg) {
+  config = cfg;
+  reset();
+}
+
+void Vad::reset() {
+  energy = 0;
+  noiseFloor = VAD_NOISE_FLOOR_MIN;
+  zcr = 0;
+  hangover_ = 0;
+  primed_ = false;
+  hitRun_ = 0;
+  hitMin_ = 0;
+}
+
+bool Vad::process(const int16_t* samples, size_t count) {
+  if (count == 0) return hangover_ > 0;
+
+  uint64_t sum = 0;
+  uint32_t crossings = 0;
+  int16_t prev = samples[0];
+  for (size_t i = 0; i < count; i++) {
+    int32_t s = samples[i];
+    sum += (uint32_t)(s * s);
+    crossings += ((s ^ prev) < 0);
+    prev = (int16_t)s;
+  }
+  energy = (uint32_t)(sum / count);
+  zcr = (uint16_t)(crossings * 1000 / count);
+
+  // First frame seeds the floor instead of being compared against it
+  if (!primed_) {
+    noiseFloor = energy > VAD_NOISE_FLOOR_MIN ? energy : VAD_NOISE_FLOOR_MIN;
+    primed_ = true;
+  }
+
+  uint64_t voicedThreshold = ((uint64_t)noiseFloor * config.energyMarginQ8) >> 8;
+  uint64_t unvoicedThreshold = ((uint64_t)noiseFloor * config.unvoicedMarginQ8) >> 8;
+
+  bool hit = energy >= config.minEnergy &&
+             (energy > voicedThreshold ||
+              (energy > unvoicedThreshold && zcr >= config.minZcrUnvoiced));
+
+  if (hit) {
+    hangover_ = config.hangoverFrames;
+    // Speech dips between syllables, noise does not: after a long enough
+    // run the quietest hit is background, and becomes the floor
+    if (hitRun_ == 0 || energy < hitMin_) hitMin_ = energy;
+    if (config.floorResetFrames && ++hitRun_ >= config.floorResetFrames) {
+      noiseFloor = hitMin_ > VAD_NOISE_FLOOR_MIN ? hitMin_ : VAD_NOISE_FLOOR_MIN;
+      hitRun_ = 0;
+    }
+  } else {
+    hitRun_ = 0;
+    // Track the floor only outside speech: fast down, slow up
+    if (energy < noiseFloor) {
+      noiseFloor -= (noiseFloor - energy) >> 2;
+    } else {
+      noiseFloor += (energy - noiseFloor) >> 6;
+    }
+    if (noiseFloor < VAD_NOISE_FLOOR_MIN) noiseFloor = VAD_NOISE_FLOOR_MIN;
+  }
+
+  if (hit) return true;
+  if (hangover_ > 0) {
+    hangover_--;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,134 @@
+#include <unity.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "adpcm.h"
+
+/*
+ * IMA-ADPCM round trip: SNR of a known signal through encode/decode at
+ * the capture frame size, and time per frame for each direction. Native
+ * runs report ns; on the board (pio test -e seeed_xiao_esp32s3) cycles.
+ */
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define BENCH_UNIT "cycles"
+static uint32_t benchNow() { return ESP.getCycleCount(); }
+#else
+#include <chrono>
+#define BENCH_UNIT "ns"
+static uint32_t benchNow() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define SAMPLE_RATE 16000
+#define FRAME_SAMPLES 480
+#define FRAMES 100                 // 3 s
+#define TOTAL_SAMPLES (FRAME_SAMPLES * FRAMES)
+
+static int16_t input[TOTAL_SAMPLES];
+static int16_t output[TOTAL_SAMPLES];
+static uint8_t block[FRAMES][ADPCM_HEADER_BYTES + FRAME_SAMPLES / 2];
+
+// Two tones plus a slow sweep: steady parts and moving ones
+static void fillSignal() {
+  float sweep = 0;
+  for (size_t i = 0; i < TOTAL_SAMPLES; i++) {
+    float t = (float)i / SAMPLE_RATE;
+    sweep += 2 * (float)M_PI * (200 + 1200 * t) / SAMPLE_RATE;
+    input[i] = (int16_t)(6000 * sinf(2 * (float)M_PI * 440 * t) +
+                         3000 * sinf(2 * (float)M_PI * 1700 * t) +
+                         4000 * sinf(sweep));
+  }
+}
+
+static float snrDb(const int16_t* a, const int16_t* b, size_t count) {
+  double signal = 0, noise = 0;
+  for (size_t i = 0; i < count; i++) {
+    double d = (double)a[i] - b[i];
+    signal += (double)a[i] * a[i];
+    noise += d * d;
+  }
+  return noise > 0 ? (float)(10 * log10(signal / noise)) : 99.0f;
+}
+
+// Encoder carries state across frames, each block decodes on its own
+static void roundTrip(uint32_t* encodeTime, uint32_t* decodeTime) {
+  AdpcmState encoder;
+  uint32_t start = benchNow();
+  for (size_t f = 0; f < FRAMES; f++) {
+    adpcmEncodeBlock(encoder, input + f * FRAME_SAMPLES, FRAME_SAMPLES, block[f]);
+  }
+  *encodeTime = benchNow() - start;
+
+  start = benchNow();
+  for (size_t f = 0; f < FRAMES; f++) {
+    AdpcmState decoder;
+    adpcmReadHeader(decoder, block[f], sizeof(block[f]));
+    adpcmDecode(decoder, block[f] + ADPCM_HEADER_BYTES, FRAME_SAMPLES / 2, output + f * FRAME_SAMPLES);
+  }
+  *decodeTime = benchNow() - start;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_block_size() {
+  TEST_ASSERT_EQUAL(ADPCM_HEADER_BYTES + FRAME_SAMPLES / 2, adpcmBlockBytes(FRAME_SAMPLES));
+  AdpcmState encoder;
+  fillSignal();
+  TEST_ASSERT_EQUAL(adpcmBlockBytes(FRAME_SAMPLES), adpcmEncodeBlock(encoder, input, FRAME_SAMPLES, block[0]));
+}
+
+void test_round_trip_snr() {
+  uint32_t encodeTime, decodeTime;
+  fillSignal();
+  roundTrip(&encodeTime, &decodeTime);
+
+  // Skip the first frame: the step size starts at its minimum
+  float snr = snrDb(input + FRAME_SAMPLES, output + FRAME_SAMPLES, TOTAL_SAMPLES - FRAME_SAMPLES);
+  char line[112];
+  snprintf(line, sizeof(line), "SNR %.1f dB; per %d-sample frame: encode %u %s, decode %u %s",
+           snr, FRAME_SAMPLES, (unsigned)(encodeTime / FRAMES), BENCH_UNIT,
+           (unsigned)(decodeTime / FRAMES), BENCH_UNIT);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE_MESSAGE(snr > 20.0f, "ADPCM round trip below 20 dB SNR");
+}
+
+void test_blocks_decode_independently() {
+  uint32_t encodeTime, decodeTime;
+  fillSignal();
+  roundTrip(&encodeTime, &decodeTime);
+
+  // A lost block must not disturb the next one
+  int16_t alone[FRAME_SAMPLES];
+  AdpcmState decoder;
+  adpcmReadHeader(decoder, block[50], sizeof(block[50]));
+  adpcmDecode(decoder, block[50] + ADPCM_HEADER_BYTES, FRAME_SAMPLES / 2, alone);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(output + 50 * FRAME_SAMPLES, alone, FRAME_SAMPLES);
+}
+
+static int runTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_block_size);
+  RUN_TEST(test_round_trip_snr);
+  RUN_TEST(test_blocks_decode_independently);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);  // let the USB serial port come up
+  runTests();
+}
+void loop() {}
+#else
+int main() {
+  return runTests();
+}
+#endif
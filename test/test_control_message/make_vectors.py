@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""
+Prints BRIDGE_VECTORS for test_main.cpp: Bridge.py encode_control() of the
+messages test_control_message builds, as C string literals, after checking
+that decode_control() gives each message back.
+
+Bridge.py's audio and LiveKit imports are stubbed out, so nothing beyond
+the standard library is needed to run it.
+"""
+
+import os
+import sys
+from unittest import mock
+
+for name in ('numpy', 'websockets', 'livekit', 'livekit.rtc', 'livekit.api', 'opuslib'):
+    sys.modules[name] = mock.MagicMock()
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', '..', 'Python files'))
+import Bridge  # noqa: E402
+
+# Same order as buildSamples()
+MESSAGES = [
+    {'type': 'silence', 'samples': 4800},
+    {'type': 'start_session', 'session_id': 'session-1234567', 'codec': 'opus'},
+    {'type': 'end_session', 'session_id': 'session-1234567', 'frames_captured': 2000,
+     'frames_dropped': 0, 'frames_suppressed': 900},
+    {'type': 'session_started', 'session_id': 'session-1234567', 'codec': 'opus',
+     'downlink_codec': 'opus'},
+    {'type': 'agent_speaking_start', 'sample_rate': 48000},
+    {'type': 'vad_config', 'enabled': True, 'hangover_frames': 12, 'energy_margin': 3.5,
+     'min_energy': 2500},
+]
+
+def literal(data: bytes) -> str:
+    """Printable runs as text, the rest as \\x escapes"""
+    parts, text = [], ''
+    for byte in data:
+        if 0x20 <= byte < 0x7F and chr(byte) not in "\"\\":
+            text += chr(byte)
+            continue
+        if text:
+            parts.append(f'"{text}"')
+            text = ''
+        if parts and parts[-1].startswith('"\\x'):
+            parts[-1] = parts[-1][:-1] + f'\\x{byte:02x}"'
+        else:
+            parts.append(f'"\\x{byte:02x}"')
+    if text:
+        parts.append(f'"{text}"')
+    return ' '.join(parts)
+
+def main():
+    for msg in MESSAGES:
+        data = Bridge.encode_control(msg)
+        assert Bridge.decode_control(data) == msg, msg['type']
+        print(f'  {{ {literal(data)}, {len(data)} }},')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,320 @@
+#include <unity.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_codec.h"
+#include "control_message.h"
+
+/*
+ * Binary control messages against their JSON form: bytes on the wire and
+ * time to encode / decode each, for the messages a session actually sends.
+ * JSON is timed the way main.cpp handles it (toJson + serializeJson out,
+ * parseJson in). Native runs report ns; on the board cycles.
+ *
+ * Also what the bridge relies on: the bytes match Bridge.py encode_control
+ * (BRIDGE_VECTORS, from make_vectors.py), and no input, however mangled,
+ * gets decode() or parseJson() out of bounds; run natively under
+ * -fsanitize=address,undefined for the latter to mean anything.
+ */
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define BENCH_UNIT "cycles"
+static uint32_t benchNow() { return ESP.getCycleCount(); }
+#else
+#include <chrono>
+#define BENCH_UNIT "ns"
+static uint32_t benchNow() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define BENCH_RUNS 2000
+#define SAMPLE_COUNT 6
+
+#ifdef ARDUINO
+#define FUZZ_RUNS 20000
+#else
+#define FUZZ_RUNS 200000
+#endif
+
+static ControlMessage samples[SAMPLE_COUNT];
+
+static void buildSamples() {
+  for (ControlMessage& m : samples) m.clear();
+
+  samples[0].type = CONTROL_SILENCE;
+  samples[0].setUint(CTRL_SAMPLES, 4800);
+
+  samples[1].type = CONTROL_START_SESSION;
+  samples[1].setString(CTRL_SESSION_ID, "session-1234567");
+  samples[1].setUint(CTRL_CODEC, CODEC_OPUS);
+
+  samples[2].type = CONTROL_END_SESSION;
+  samples[2].setString(CTRL_SESSION_ID, "session-1234567");
+  samples[2].setUint(CTRL_FRAMES_CAPTURED, 2000);
+  samples[2].setUint(CTRL_FRAMES_DROPPED, 0);
+  samples[2].setUint(CTRL_FRAMES_SUPPRESSED, 900);
+
+  samples[3].type = CONTROL_SESSION_STARTED;
+  samples[3].setString(CTRL_SESSION_ID, "session-1234567");
+  samples[3].setUint(CTRL_CODEC, CODEC_OPUS);
+  samples[3].setUint(CTRL_DOWNLINK_CODEC, CODEC_OPUS);
+
+  samples[4].type = CONTROL_AGENT_SPEAKING_START;
+  samples[4].setUint(CTRL_SAMPLE_RATE, 48000);
+
+  samples[5].type = CONTROL_VAD_CONFIG;
+  samples[5].setBool(CTRL_ENABLED, true);
+  samples[5].setUint(CTRL_HANGOVER_FRAMES, 12);
+  samples[5].setUint(CTRL_ENERGY_MARGIN, 3 * 256 + 128);  // 3.5
+  samples[5].setUint(CTRL_MIN_ENERGY, 2500);
+}
+
+// Every field a sample sets, for parseJson's filter
+static uint32_t fieldMask(const ControlMessage& m) {
+  uint32_t mask = 0;
+  for (int tag = 1; tag < CTRL_TAG_COUNT; tag++) {
+    if (m.has((ControlTag)tag)) mask |= CTRL_BIT(tag);
+  }
+  return mask;
+}
+
+static size_t writeJson(const ControlMessage& m, char* out, size_t capacity) {
+  StaticJsonDocument<CONTROL_JSON_DOC_BYTES> doc;
+  m.toJson(doc);
+  return serializeJson(doc, out, capacity);
+}
+
+static bool sameFields(const ControlMessage& a, const ControlMessage& b) {
+  if (a.type != b.type) return false;
+  for (int tag = 1; tag < CTRL_TAG_COUNT; tag++) {
+    ControlTag t = (ControlTag)tag;
+    if (a.has(t) != b.has(t)) return false;
+    if (!a.has(t)) continue;
+    if (tag <= CTRL_TEXT) {
+      if (strcmp(a.getString(t, ""), b.getString(t, "")) != 0) return false;
+    } else if (a.getUint(t, 0) != b.getUint(t, 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Bridge.py encode_control() of the same messages, in the same order
+static const struct { const char* bytes; size_t length; } BRIDGE_VECTORS[SAMPLE_COUNT] = {
+  { "\xc1\x07\x0f\x02\xc0\x12", 6 },
+  { "\xc1\x03\x01\x0f" "session-1234567" "\x05\x01\x01", 22 },
+  { "\xc1\x05\x01\x0f" "session-1234567" "\x15\x02\xd0\x07\x16\x01\x00\x17\x02\x84\x03", 30 },
+  { "\xc1\x04\x01\x0f" "session-1234567" "\x05\x01\x01\x07\x01\x01", 25 },
+  { "\xc1\x0d\x09\x02\x80\xbb", 6 },
+  { "\xc1\x09\x10\x01\x01\x11\x01\x0c\x12\x02\x80\x03\x13\x02\xc4\x09", 16 },
+};
+
+// xorshift32: the same inputs on every run and every platform
+static uint32_t fuzzState;
+static uint32_t fuzzNext() {
+  fuzzState ^= fuzzState << 13;
+  fuzzState ^= fuzzState >> 17;
+  fuzzState ^= fuzzState << 5;
+  return fuzzState;
+}
+
+// Flip bytes, truncate, or replace with noise; the magic stays so decode gets past it
+static size_t mutate(uint8_t* buf, size_t length, size_t capacity) {
+  switch (fuzzNext() % 4) {
+    case 0:
+      for (int k = fuzzNext() % 4; k >= 0 && length; k--) buf[fuzzNext() % length] = (uint8_t)fuzzNext();
+      break;
+    case 1:
+      length = fuzzNext() % (length + 1);
+      break;
+    case 2:
+      length = fuzzNext() % capacity;
+      for (size_t i = 0; i < length; i++) buf[i] = (uint8_t)fuzzNext();
+      break;
+    default:
+      break;
+  }
+  if (length) buf[0] = CONTROL_MAGIC;
+  return length;
+}
+
+void setUp() {
+  buildSamples();
+  fuzzState = 0x2545F491;
+}
+void tearDown() {}
+
+void test_both_forms_round_trip() {
+  for (const ControlMessage& m : samples) {
+    uint8_t binary[CONTROL_MAX_BYTES];
+    size_t binaryBytes = m.encode(binary, sizeof(binary));
+    TEST_ASSERT_TRUE(binaryBytes > 0);
+    ControlMessage fromBinary;
+    TEST_ASSERT_TRUE(fromBinary.decode(binary, binaryBytes));
+    TEST_ASSERT_TRUE_MESSAGE(sameFields(m, fromBinary), controlTypeName(m.type));
+
+    char json[CONTROL_MAX_BYTES];
+    size_t jsonBytes = writeJson(m, json, sizeof(json));
+    TEST_ASSERT_TRUE(jsonBytes > 0);
+    ControlMessage fromJson;
+    TEST_ASSERT_TRUE(fromJson.parseJson(json, jsonBytes, fieldMask(m)));
+    TEST_ASSERT_TRUE_MESSAGE(sameFields(m, fromJson), json);
+  }
+}
+
+void test_binary_smaller_and_faster_than_json() {
+  uint32_t binaryTotal = 0, jsonTotal = 0;
+  for (const ControlMessage& m : samples) {
+    uint8_t binary[CONTROL_MAX_BYTES];
+    char json[CONTROL_MAX_BYTES];
+    size_t binaryBytes = m.encode(binary, sizeof(binary));
+    size_t jsonBytes = writeJson(m, json, sizeof(json));
+    uint32_t mask = fieldMask(m);
+    ControlMessage decoded;
+    volatile size_t sink = 0;
+
+    uint32_t start = benchNow();
+    for (int i = 0; i < BENCH_RUNS; i++) sink += m.encode(binary, sizeof(binary));
+    uint32_t binaryEncode = (benchNow() - start) / BENCH_RUNS;
+
+    start = benchNow();
+    for (int i = 0; i < BENCH_RUNS; i++) sink += decoded.decode(binary, binaryBytes);
+    uint32_t binaryDecode = (benchNow() - start) / BENCH_RUNS;
+
+    start = benchNow();
+    for (int i = 0; i < BENCH_RUNS; i++) sink += writeJson(m, json, sizeof(json));
+    uint32_t jsonEncode = (benchNow() - start) / BENCH_RUNS;
+
+    start = benchNow();
+    for (int i = 0; i < BENCH_RUNS; i++) sink += decoded.parseJson(json, jsonBytes, mask);
+    uint32_t jsonDecode = (benchNow() - start) / BENCH_RUNS;
+    (void)sink;
+
+    char line[160];
+    snprintf(line, sizeof(line), "%-20s binary %3u B enc %4u dec %4u | json %3u B enc %5u dec %5u %s",
+             controlTypeName(m.type), (unsigned)binaryBytes, (unsigned)binaryEncode,
+             (unsigned)binaryDecode, (unsigned)jsonBytes, (unsigned)jsonEncode,
+             (unsigned)jsonDecode, BENCH_UNIT);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE_MESSAGE(binaryBytes < jsonBytes, controlTypeName(m.type));
+
+    binaryTotal += binaryEncode + binaryDecode;
+    jsonTotal += jsonEncode + jsonDecode;
+  }
+  TEST_ASSERT_TRUE_MESSAGE(binaryTotal < jsonTotal, "binary encode + decode not faster than JSON");
+}
+
+void test_matches_bridge_encoding() {
+  for (int i = 0; i < SAMPLE_COUNT; i++) {
+    uint8_t binary[CONTROL_MAX_BYTES];
+    size_t binaryBytes = samples[i].encode(binary, sizeof(binary));
+    TEST_ASSERT_EQUAL_MESSAGE(BRIDGE_VECTORS[i].length, binaryBytes, controlTypeName(samples[i].type));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(BRIDGE_VECTORS[i].bytes, binary, binaryBytes);
+
+    ControlMessage decoded;
+    TEST_ASSERT_TRUE(decoded.decode((const uint8_t*)BRIDGE_VECTORS[i].bytes, BRIDGE_VECTORS[i].length));
+    TEST_ASSERT_TRUE_MESSAGE(sameFields(samples[i], decoded), controlTypeName(samples[i].type));
+  }
+}
+
+void test_type_names() {
+  for (int type = 1; type < CONTROL_TYPE_COUNT; type++) {
+    TEST_ASSERT_EQUAL(type, controlTypeFromName(controlTypeName((ControlType)type)));
+  }
+  const char* bad[] = { "", "Ready", "ready ", "readyx", "unknown", "agent_speaking", nullptr };
+  for (const char* name : bad) TEST_ASSERT_EQUAL(CONTROL_UNKNOWN, controlTypeFromName(name));
+}
+
+void test_fuzz_binary() {
+  // Seeds: every sample plus each type with random integer fields
+  static uint8_t seeds[SAMPLE_COUNT + CONTROL_TYPE_COUNT][CONTROL_MAX_BYTES];  // off the loop task stack
+  size_t seedBytes[SAMPLE_COUNT + CONTROL_TYPE_COUNT];
+  for (int i = 0; i < SAMPLE_COUNT; i++) seedBytes[i] = samples[i].encode(seeds[i], CONTROL_MAX_BYTES);
+  for (int type = 0; type < CONTROL_TYPE_COUNT; type++) {
+    ControlMessage m((ControlType)type);
+    m.setString(CTRL_SESSION_ID, "session-1");
+    m.setString(CTRL_TEXT, "hello");
+    for (int tag = CTRL_CODEC; tag < CTRL_TAG_COUNT; tag++) {
+      if (fuzzNext() & 1) m.setUint((ControlTag)tag, fuzzNext());
+    }
+    seedBytes[SAMPLE_COUNT + type] = m.encode(seeds[SAMPLE_COUNT + type], CONTROL_MAX_BYTES);
+  }
+
+  uint32_t accepted = 0;
+  for (uint32_t run = 0; run < FUZZ_RUNS; run++) {
+    uint8_t input[CONTROL_MAX_BYTES];
+    size_t seed = fuzzNext() % (SAMPLE_COUNT + CONTROL_TYPE_COUNT);
+    memcpy(input, seeds[seed], seedBytes[seed]);
+    size_t length = mutate(input, seedBytes[seed], sizeof(input));
+
+    ControlMessage decoded;
+    if (!decoded.decode(input, length)) continue;
+    accepted++;
+
+    // Whatever decode accepted re-encodes canonically and survives another trip
+    uint8_t first[2 * CONTROL_MAX_BYTES], second[2 * CONTROL_MAX_BYTES];
+    size_t firstBytes = decoded.encode(first, sizeof(first));
+    TEST_ASSERT_TRUE(firstBytes > 0);
+    ControlMessage again;
+    TEST_ASSERT_TRUE(again.decode(first, firstBytes));
+    TEST_ASSERT_TRUE(sameFields(decoded, again));
+    size_t secondBytes = again.encode(second, sizeof(second));
+    TEST_ASSERT_EQUAL(firstBytes, secondBytes);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(first, second, firstBytes);
+  }
+
+  char line[64];
+  snprintf(line, sizeof(line), "%u of %u mutated messages decoded", (unsigned)accepted, (unsigned)FUZZ_RUNS);
+  TEST_MESSAGE(line);
+}
+
+void test_fuzz_json() {
+  static char seeds[SAMPLE_COUNT][CONTROL_MAX_BYTES];
+  size_t seedBytes[SAMPLE_COUNT];
+  for (int i = 0; i < SAMPLE_COUNT; i++) seedBytes[i] = writeJson(samples[i], seeds[i], sizeof(seeds[i]));
+
+  for (uint32_t run = 0; run < FUZZ_RUNS / 10; run++) {
+    char input[CONTROL_MAX_BYTES];
+    size_t seed = fuzzNext() % SAMPLE_COUNT;
+    memcpy(input, seeds[seed], seedBytes[seed]);
+    size_t length = mutate((uint8_t*)input, seedBytes[seed], sizeof(input));
+    if (length) input[0] = '{';
+
+    ControlMessage parsed;
+    ControlType peeked = peekControlType(input, length);
+    if (parsed.parseJson(input, length, 0xFFFFFFFFUL)) {
+      TEST_ASSERT_EQUAL(peeked, parsed.type);
+      if (parsed.has(CTRL_SESSION_ID)) {
+        TEST_ASSERT_TRUE(strlen(parsed.getString(CTRL_SESSION_ID, "")) < CONTROL_STRING_POOL);
+      }
+    }
+  }
+}
+
+static int runTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_both_forms_round_trip);
+  RUN_TEST(test_binary_smaller_and_faster_than_json);
+  RUN_TEST(test_matches_bridge_encoding);
+  RUN_TEST(test_type_names);
+  RUN_TEST(test_fuzz_binary);
+  RUN_TEST(test_fuzz_json);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);  // let the USB serial port come up
+  runTests();
+}
+void loop() {}
+#else
+int main() {
+  return runTests();
+}
+#endif
@@ -0,0 +1,201 @@
+#include <unity.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "echo_canceller.h"
+
+/*
+ * EchoCanceller on a synthetic echo mix: a speech-like far end played
+ * through a simulated room into the mic, with room noise and a second of
+ * near-end talk in the middle (double talk), louder than the echo as a
+ * user right by the device would be. ERLE is measured from the mic and
+ * output energies, per section: far end only after the filter has
+ * converged, and right after the double talk (detection must have rolled
+ * the near end's adaptation back; without it this window loses ~10 dB).
+ * Also reports the time per 30 ms capture frame, native in ns, on the
+ * board (pio test -e seeed_xiao_esp32s3) in cycles, where it must stay
+ * inside MAX_FRAME_CYCLES.
+ */
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define BENCH_UNIT "cycles"
+static uint32_t benchNow() { return ESP.getCycleCount(); }
+#else
+#include <chrono>
+#define BENCH_UNIT "ns"
+static uint32_t benchNow() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define SAMPLE_RATE 16000
+#define FRAME_SAMPLES 480          // capture frame
+#define PLAYBACK_BLOCK 160         // reference pushed per playback block
+#define SECONDS 6
+#define ECHO_TAPS 200              // room response, shorter than the filter
+#define STEP_Q15 8192              // AEC_STEP_Q15 in main.cpp
+#define NEAR_START_S 3              // double talk from 3 s to 4 s
+#define NEAR_END_S 4
+#define RECOVER_MS 300              // window right after the double talk
+#define MIN_ERLE_DB 20.0f
+#define MAX_RECOVERY_LOSS_DB 3.0f  // right after double talk vs converged
+#define MAX_FRAME_CYCLES 1800000   // a quarter of a 30 ms frame at 240 MHz
+
+static float room[ECHO_TAPS];
+static int16_t farHistory[ECHO_TAPS];   // newest at farPos
+static size_t farPos = 0;
+static uint32_t rng = 1;
+
+static float noise() {
+  rng = rng * 1664525u + 1013904223u;
+  return ((int32_t)(rng >> 16) - 32768) / 32768.0f;
+}
+
+// Direct path after 2 ms, then a decaying tail of reflections
+static void buildRoom() {
+  for (size_t k = 0; k < ECHO_TAPS; k++) {
+    room[k] = k < 32 ? 0 : 0.35f * expf(-(float)(k - 32) / 30.0f) * ((k % 3) ? 1.0f : -0.5f);
+  }
+}
+
+// Voiced far-end "speech": wandering pitch under a syllable envelope
+static int16_t farSample(size_t i) {
+  static float phase = 0;
+  float t = (float)i / SAMPLE_RATE;
+  phase += 2 * (float)M_PI * (150 + 40 * sinf(2 * (float)M_PI * 0.7f * t)) / SAMPLE_RATE;
+  float envelope = 0.3f + 0.7f * fabsf(sinf((float)M_PI * 4 * t));
+  float voiced = sinf(phase) + 0.5f * sinf(2 * phase) + 0.3f * sinf(3 * phase);
+  return (int16_t)(5000 * envelope * voiced + 600 * noise());
+}
+
+static uint64_t energy(const int16_t* pcm, size_t samples) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < samples; i++) sum += (int32_t)pcm[i] * pcm[i];
+  return sum;
+}
+
+static float erleDb(uint64_t echo, uint64_t residual) {
+  return residual ? 10.0f * log10f((float)echo / (float)residual) : 99.0f;
+}
+
+static int16_t micSample(int16_t far, size_t i) {
+  farPos = (farPos + 1) % ECHO_TAPS;
+  farHistory[farPos] = far;
+  float echo = 0;
+  for (size_t k = 0; k < ECHO_TAPS; k++) {
+    echo += room[k] * farHistory[(farPos + ECHO_TAPS - k) % ECHO_TAPS];
+  }
+  float near = 0;
+  if (i >= NEAR_START_S * SAMPLE_RATE && i < NEAR_END_S * SAMPLE_RATE) {
+    // Double talk: a louder talker close to the mic, uncorrelated with the far end
+    near = 24000 * noise() * (0.5f + 0.5f * fabsf(sinf((float)M_PI * 3 * i / SAMPLE_RATE)));
+  }
+  float x = echo + near + 30 * noise();
+  return (int16_t)(x > 32767 ? 32767 : (x < -32768 ? -32768 : x));
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_erle_and_cost() {
+  static EchoCanceller aec;
+  TEST_ASSERT_TRUE(aec.begin(SAMPLE_RATE, STEP_Q15));
+  buildRoom();
+
+  int16_t far[FRAME_SAMPLES];
+  int16_t mic[FRAME_SAMPLES];
+  const uint32_t startUs = 1000000;   // playout time of sample 0
+  uint32_t elapsed = 0;
+  size_t frames = 0;
+  uint64_t echoBefore = 0, residualBefore = 0;   // 1 s .. NEAR_START_S
+  uint64_t echoAfter = 0, residualAfter = 0;     // NEAR_END_S .. end
+  uint64_t echoRecover = 0, residualRecover = 0; // first RECOVER_MS of that
+
+  for (size_t f = 0; f + FRAME_SAMPLES <= SECONDS * SAMPLE_RATE; f += FRAME_SAMPLES) {
+    for (size_t i = 0; i < FRAME_SAMPLES; i++) {
+      far[i] = farSample(f + i);
+      mic[i] = micSample(far[i], f + i);
+    }
+    // The playback task pushes 10 ms blocks; the mic hears them as played
+    for (size_t b = 0; b < FRAME_SAMPLES; b += PLAYBACK_BLOCK) {
+      aec.pushReference(far + b, PLAYBACK_BLOCK,
+                        startUs + (uint32_t)((uint64_t)(f + b) * 1000000 / SAMPLE_RATE));
+    }
+
+    uint64_t micEnergy = energy(mic, FRAME_SAMPLES);
+    uint32_t start = benchNow();
+    aec.process(mic, FRAME_SAMPLES, startUs + (uint32_t)((uint64_t)f * 1000000 / SAMPLE_RATE));
+    elapsed += benchNow() - start;
+    frames++;
+
+    if (f >= 1 * SAMPLE_RATE && f + FRAME_SAMPLES <= NEAR_START_S * SAMPLE_RATE) {
+      echoBefore += micEnergy;
+      residualBefore += energy(mic, FRAME_SAMPLES);
+    } else if (f >= NEAR_END_S * SAMPLE_RATE) {
+      uint64_t residual = energy(mic, FRAME_SAMPLES);
+      echoAfter += micEnergy;
+      residualAfter += residual;
+      if (f < NEAR_END_S * SAMPLE_RATE + RECOVER_MS * SAMPLE_RATE / 1000) {
+        echoRecover += micEnergy;
+        residualRecover += residual;
+      }
+    }
+  }
+
+  float before = erleDb(echoBefore, residualBefore);
+  float after = erleDb(echoAfter, residualAfter);
+  float recover = erleDb(echoRecover, residualRecover);
+  char line[192];
+  snprintf(line, sizeof(line), "ERLE %.1f dB converged, %.1f dB in the %d ms after double talk, %.1f dB to the end (%u of %u frames flagged); %u %s per %d-sample frame",
+           before, recover, RECOVER_MS, after, (unsigned)aec.doubleTalkFrames, (unsigned)aec.farEndFrames,
+           (unsigned)(elapsed / frames), BENCH_UNIT, FRAME_SAMPLES);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE_MESSAGE(before >= MIN_ERLE_DB, "ERLE below MIN_ERLE_DB");
+  TEST_ASSERT_TRUE_MESSAGE(aec.doubleTalkFrames > 0, "double talk never detected");
+  TEST_ASSERT_TRUE_MESSAGE(recover >= before - MAX_RECOVERY_LOSS_DB, "double talk wrecked the echo path estimate");
+  TEST_ASSERT_TRUE_MESSAGE(after >= MIN_ERLE_DB, "ERLE below MIN_ERLE_DB after double talk");
+#ifdef ARDUINO
+  TEST_ASSERT_TRUE_MESSAGE(elapsed / frames <= MAX_FRAME_CYCLES, "AEC over its share of the capture core");
+#endif
+}
+
+void test_silent_reference_passes_mic_through() {
+  static EchoCanceller aec;
+  TEST_ASSERT_TRUE(aec.begin(SAMPLE_RATE, STEP_Q15));
+
+  int16_t silence[PLAYBACK_BLOCK] = {};
+  int16_t mic[FRAME_SAMPLES];
+  int16_t expected[FRAME_SAMPLES];
+  for (size_t i = 0; i < FRAME_SAMPLES; i++) {
+    mic[i] = expected[i] = (int16_t)(3000 * sinf(2 * (float)M_PI * 440 * i / SAMPLE_RATE));
+  }
+  for (size_t b = 0; b < FRAME_SAMPLES; b += PLAYBACK_BLOCK) {
+    aec.pushReference(silence, PLAYBACK_BLOCK, 1000000 + (uint32_t)(b * 1000000 / SAMPLE_RATE));
+  }
+  aec.process(mic, FRAME_SAMPLES, 1000000);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(expected, mic, FRAME_SAMPLES);
+}
+
+static int runTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_erle_and_cost);
+  RUN_TEST(test_silent_reference_passes_mic_through);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);  // let the USB serial port come up
+  runTests();
+}
+void loop() {}
+#else
+int main() {
+  return runTests();
+}
+#endif
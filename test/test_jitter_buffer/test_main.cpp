@@ -0,0 +1,131 @@
+#include <unity.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "jitter_buffer.h"
+
+/*
+ * JitterBuffer driven the way main.cpp drives it: the network side
+ * writes and resets, the playback task polls active() and reads
+ * 10 ms blocks. Both sides run on this one thread, in the interleavings
+ * that matter.
+ */
+
+#define SAMPLE_RATE 16000
+#define BLOCK 160                  // PLAYBACK_BLOCK in main.cpp
+#define MIN_DELAY_MS 40            // JITTER_MIN_MS
+#define MAX_DELAY_MS 300           // JITTER_MAX_MS
+
+static JitterBuffer* jb;
+static int16_t tone[4800];
+static int16_t block[BLOCK];
+
+void setUp() {
+  jb = new JitterBuffer();
+  TEST_ASSERT_TRUE(jb->begin(SAMPLE_RATE, MIN_DELAY_MS, MAX_DELAY_MS));
+  for (size_t i = 0; i < sizeof(tone) / sizeof(tone[0]); i++) {
+    tone[i] = (i / 8) % 2 ? 8000 : -8000;
+  }
+}
+
+void tearDown() {
+  delete jb;
+}
+
+void test_reset_keeps_audio_written_after_it() {
+  // agent_speaking_start: reset, then the early TTS audio is flushed in
+  jb->reset();
+  jb->write(tone, 4800);
+  TEST_ASSERT_TRUE(jb->active());
+  TEST_ASSERT_EQUAL(4800, jb->depth());
+}
+
+void test_reset_drops_audio_written_before_it() {
+  jb->write(tone, 2000);
+  jb->reset();
+  jb->write(tone, 1000);  // arrives before the playback task wakes
+  jb->active();
+  TEST_ASSERT_EQUAL(1000, jb->depth());
+}
+
+void test_reset_after_reads() {
+  jb->write(tone, 2000);
+  TEST_ASSERT_TRUE(jb->active());
+  jb->read(block, BLOCK);
+  jb->reset();
+  jb->write(tone, 500);
+  TEST_ASSERT_EQUAL(0, jb->read(block, BLOCK));  // applies the reset, then prebuffers
+  TEST_ASSERT_EQUAL(500, jb->depth());
+}
+
+void test_underrun_conceals_three_decaying_repeats() {
+  jb->write(tone, 800);  // 50 ms, above the 40 ms target
+  size_t played = 0;
+  while (played < 800) {
+    TEST_ASSERT_TRUE(jb->active());
+    played += jb->read(block, BLOCK);
+  }
+  TEST_ASSERT_EQUAL(0, jb->underruns);
+
+  // Starved: the task keeps reading for 3 x 10 ms, each block quieter
+  int32_t previousPeak = 32767;
+  for (int repeat = 0; repeat < 3; repeat++) {
+    TEST_ASSERT_TRUE_MESSAGE(jb->active(), "stopped concealing early");
+    TEST_ASSERT_EQUAL(0, jb->read(block, BLOCK));
+    int32_t peak = 0;
+    for (size_t i = 0; i < BLOCK; i++) {
+      int32_t a = block[i] < 0 ? -block[i] : block[i];
+      if (a > peak) peak = a;
+    }
+    TEST_ASSERT_EQUAL(8000 >> (repeat + 1), peak);
+    TEST_ASSERT_LESS_THAN(previousPeak, peak);
+    previousPeak = peak;
+  }
+  TEST_ASSERT_FALSE(jb->active());
+  TEST_ASSERT_EQUAL(1, jb->underruns);
+  TEST_ASSERT_EQUAL(3 * BLOCK, jb->concealed);
+}
+
+void test_refill_during_concealment_resumes_playout() {
+  jb->write(tone, 800);
+  while (jb->read(block, BLOCK) > 0) {}
+  TEST_ASSERT_TRUE(jb->active());  // concealing
+
+  jb->write(tone, 800);
+  TEST_ASSERT_TRUE(jb->active());
+  TEST_ASSERT_EQUAL(BLOCK, jb->read(block, BLOCK));
+  TEST_ASSERT_EQUAL_INT16_ARRAY(tone, block, BLOCK);
+}
+
+void test_end_of_stream_is_not_concealed() {
+  jb->write(tone, 500);   // short reply, below the target
+  jb->endOfStream();
+  size_t played = 0;
+  while (jb->active()) {
+    played += jb->read(block, BLOCK);
+  }
+  TEST_ASSERT_EQUAL(500, played);
+  TEST_ASSERT_EQUAL(0, jb->underruns);
+  TEST_ASSERT_EQUAL(0, jb->concealed);
+}
+
+void test_idle_buffer_is_inactive() {
+  TEST_ASSERT_FALSE(jb->active());
+  jb->reset();
+  TEST_ASSERT_FALSE(jb->active());
+  TEST_ASSERT_EQUAL(0, jb->read(block, BLOCK));
+  TEST_ASSERT_FALSE(jb->active());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_reset_keeps_audio_written_after_it);
+  RUN_TEST(test_reset_drops_audio_written_before_it);
+  RUN_TEST(test_reset_after_reads);
+  RUN_TEST(test_underrun_conceals_three_decaying_repeats);
+  RUN_TEST(test_refill_during_concealment_resumes_playout);
+  RUN_TEST(test_end_of_stream_is_not_concealed);
+  RUN_TEST(test_idle_buffer_is_inactive);
+  return UNITY_END();
+}
@@ -0,0 +1,154 @@
+#include <unity.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "resampler.h"
+
+/*
+ * Resampler on the TTS rates the bridge declares, fed in uneven chunks
+ * as the downlink delivers them, and on rates it must refuse quickly.
+ * Also the time per 10 ms of output for each of those rates: native runs
+ * report ns, on the board CPU cycles.
+ */
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define BENCH_UNIT "cycles"
+static uint32_t benchNow() { return ESP.getCycleCount(); }
+#else
+#include <chrono>
+#define BENCH_UNIT "ns"
+static uint32_t benchNow() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define OUTPUT_RATE 16000
+#define BENCH_SECONDS 5
+
+static int16_t input[48000];         // 1 s at the highest rate
+static int16_t output[OUTPUT_RATE + 64];
+
+// Returns output samples; RMS of the second half (past the filter delay) in *rms
+static size_t resampleTone(Resampler& rs, uint32_t rate, float hz, float* rms) {
+  for (uint32_t i = 0; i < rate; i++) {
+    input[i] = (int16_t)(10000 * sinf(2 * (float)M_PI * hz * i / rate));
+  }
+  size_t in = 0, out = 0, chunk = 1;
+  int16_t block[Resampler::MAX_INPUT + 1];
+  while (in < rate) {
+    size_t take = chunk;
+    if (take > rate - in) take = rate - in;
+    if (take > Resampler::MAX_INPUT) take = Resampler::MAX_INPUT;
+    size_t n = rs.process(input + in, take, block);
+    if (out + n > sizeof(output) / sizeof(output[0])) n = sizeof(output) / sizeof(output[0]) - out;
+    memcpy(output + out, block, n * sizeof(int16_t));
+    in += take;
+    out += n;
+    chunk = chunk * 7 % 479 + 1;
+  }
+
+  double sum = 0;
+  for (size_t i = out / 2; i < out; i++) sum += (double)output[i] * output[i];
+  *rms = (float)sqrt(sum / (out - out / 2));
+  return out;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_tts_rates_pass_speech_band() {
+  const uint32_t rates[] = { 48000, 44100, 24000, 22050 };
+  for (uint32_t rate : rates) {
+    Resampler rs;
+    TEST_ASSERT_TRUE(rs.begin(rate, OUTPUT_RATE));
+    float rms;
+    size_t out = resampleTone(rs, rate, 1000, &rms);
+    TEST_ASSERT_TRUE(out >= OUTPUT_RATE - 2 && out <= OUTPUT_RATE + 2);
+    TEST_ASSERT_TRUE_MESSAGE(rms > 6500 && rms < 7600, "1 kHz tone not passed at unity");
+  }
+}
+
+void test_above_output_nyquist_is_rejected() {
+  Resampler rs;
+  TEST_ASSERT_TRUE(rs.begin(48000, OUTPUT_RATE));
+  float rms;
+  resampleTone(rs, 48000, 11000, &rms);
+  TEST_ASSERT_TRUE_MESSAGE(rms < 300, "11 kHz tone aliased into the output");
+}
+
+void test_odd_rates_fall_back_to_passthrough() {
+  // L = 16000 and L = 1000: megabytes of taps if they were built
+  const uint32_t rates[] = { 47999, 16001, 8000, 0 };
+  for (uint32_t rate : rates) {
+    Resampler rs;
+    TEST_ASSERT_FALSE(rs.begin(rate, OUTPUT_RATE));
+    TEST_ASSERT_TRUE(rs.passthrough());
+  }
+}
+
+void test_same_rate_is_passthrough() {
+  Resampler rs;
+  TEST_ASSERT_TRUE(rs.begin(OUTPUT_RATE, OUTPUT_RATE));
+  TEST_ASSERT_TRUE(rs.passthrough());
+}
+
+void test_benchmark_per_frame() {
+  // 10 ms of input per call, as the bridge streams it; 22.05 kHz alternates
+  // 220 and 221 samples so the phase keeps moving
+  const uint32_t rates[] = { 48000, 44100, 24000, 22050 };
+  for (uint32_t rate : rates) {
+    for (uint32_t i = 0; i < rate; i++) {
+      input[i] = (int16_t)(10000 * sinf(2 * (float)M_PI * 440 * i / rate));
+    }
+    Resampler rs;
+    TEST_ASSERT_TRUE(rs.begin(rate, OUTPUT_RATE));
+    int16_t block[Resampler::MAX_INPUT + 1];
+    size_t produced = 0;
+
+    uint32_t start = benchNow();
+    for (int second = 0; second < BENCH_SECONDS; second++) {
+      size_t in = 0;
+      for (int call = 1; call <= 100; call++) {
+        size_t take = rate * call / 100 - in;
+        produced += rs.process(input + in, take, block);
+        in += take;
+      }
+    }
+    uint32_t elapsed = benchNow() - start;
+
+    size_t frames = produced / (OUTPUT_RATE / 100);
+    char line[96];
+    snprintf(line, sizeof(line), "%u Hz -> %u Hz: %u %s per 10 ms output frame",
+             (unsigned)rate, (unsigned)OUTPUT_RATE, (unsigned)(elapsed / frames), BENCH_UNIT);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(produced >= BENCH_SECONDS * OUTPUT_RATE - 2 &&
+                     produced <= BENCH_SECONDS * OUTPUT_RATE + 2);
+  }
+}
+
+static int runTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_tts_rates_pass_speech_band);
+  RUN_TEST(test_above_output_nyquist_is_rejected);
+  RUN_TEST(test_odd_rates_fall_back_to_passthrough);
+  RUN_TEST(test_same_rate_is_passthrough);
+  RUN_TEST(test_benchmark_per_frame);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+  delay(2000);  // let the USB serial port come up
+  runTests();
+}
+void loop() {}
+#else
+int main() {
+  return runTests();
+}
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Just enough of Arduino-ESP32 for main.cpp to build on the host
+ * (test_session_soak). Pins, timers and the serial port do nothing;
+ * millis() returns stubMillis, which the test advances.
+ */
+
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+// Heap-backed like WString.cpp, so a String on the session path shows
+// up in the soak's allocation count
+class String {
+public:
+  String(const char* text = "") { assign(text ? text : ""); }
+  String(const String& other) { assign(other.buf_); }
+  String& operator=(const String& other) {
+    if (this != &other) assign(other.buf_);
+    return *this;
+  }
+  ~String() { free(buf_); }
+  const char* c_str() const { return buf_; }
+  size_t length() const { return strlen(buf_); }
+
+private:
+  void assign(const char* text) {
+    size_t n = strlen(text);
+    char* next = (char*)realloc(buf_, n + 1);
+    memcpy(next, text, n + 1);
+    buf_ = next;
+  }
+  char* buf_ = nullptr;
+};
+
+struct HardwareSerial {
+  void begin(unsigned long) {}
+  size_t print(const char*) { return 0; }
+  size_t write(const uint8_t*, size_t length) { return length; }
+  void flush() {}
+};
+extern HardwareSerial Serial;
+
+struct EspClass {
+  uint64_t getEfuseMac() { return 0x1234567890ABULL; }
+  uint32_t getCycleCount() { return 0; }
+};
+extern EspClass ESP;
+
+extern uint32_t stubMillis;
+inline uint32_t millis() { return stubMillis; }
+inline void delay(uint32_t) {}
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+
+inline void* ps_malloc(size_t size) { return malloc(size); }
+inline uint32_t esp_random() { return 0x12345678; }
+inline void esp_deep_sleep_start() {}
+
+using std::min;
+using std::max;
+
+#define SET_LOOP_TASK_STACK_SIZE(size) \
+  size_t getArduinoLoopTaskStackSize(void) { return size; }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define WEBSOCKETS_MAX_HEADER_SIZE 14
+
+typedef enum {
+  WStype_ERROR,
+  WStype_DISCONNECTED,
+  WStype_CONNECTED,
+  WStype_TEXT,
+  WStype_BIN,
+  WStype_FRAGMENT_TEXT_START,
+  WStype_FRAGMENT_BIN_START,
+  WStype_FRAGMENT,
+  WStype_FRAGMENT_FIN,
+  WStype_PING,
+  WStype_PONG,
+} WStype_t;
+
+// Counts what main.cpp sends; the test plays the bridge by calling
+// webSocketEvent() directly
+class WebSocketsClient {
+public:
+  void begin(const char*, uint16_t, const char* = "/") {}
+  void onEvent(void (*)(WStype_t, uint8_t*, size_t)) {}
+  void setReconnectInterval(unsigned long) {}
+  void loop() {}
+  bool sendTXT(const char*, size_t) {
+    textSent++;
+    return true;
+  }
+  bool sendBIN(uint8_t*, size_t, bool = false) {
+    binarySent++;
+    return true;
+  }
+  bool sendBIN(const uint8_t*, size_t) {
+    binarySent++;
+    return true;
+  }
+
+  uint32_t textSent = 0;
+  uint32_t binarySent = 0;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define WIFI_STA 1
+#define WL_CONNECTED 3
+
+struct IPAddress {
+  String toString() const { return String("127.0.0.1"); }
+};
+
+struct WiFiClass {
+  void mode(int) {}
+  void begin(const char*, const char*) {}
+  int status() { return WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress(); }
+  int hostByName(const char*, IPAddress&) { return 1; }
+};
+extern WiFiClass WiFi;
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "WiFi.h"
+
+// RTP datagrams go nowhere; parsePacket() never has anything
+struct WiFiUDP {
+  uint8_t begin(uint16_t) { return 1; }
+  void stop() {}
+  int beginPacket(IPAddress, uint16_t) { return 1; }
+  size_t write(const uint8_t*, size_t length) { return length; }
+  int endPacket() { return 1; }
+  int parsePacket() { return 0; }
+  int read(uint8_t*, size_t) { return 0; }
+  IPAddress remoteIP() { return IPAddress(); }
+  uint16_t remotePort() { return 0; }
+};
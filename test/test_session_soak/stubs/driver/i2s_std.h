@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// The fields main.cpp fills in; channels read nothing and write nowhere
+typedef struct i2s_channel* i2s_chan_handle_t;
+typedef int i2s_port_t;
+typedef int gpio_num_t;
+
+#define I2S_NUM_0 0
+#define I2S_NUM_1 1
+#define I2S_GPIO_UNUSED ((gpio_num_t)-1)
+
+typedef enum { I2S_ROLE_MASTER, I2S_ROLE_SLAVE } i2s_role_t;
+typedef enum { I2S_DATA_BIT_WIDTH_16BIT = 16, I2S_DATA_BIT_WIDTH_32BIT = 32 } i2s_data_bit_width_t;
+typedef enum { I2S_SLOT_MODE_MONO = 1, I2S_SLOT_MODE_STEREO = 2 } i2s_slot_mode_t;
+typedef enum { I2S_STD_SLOT_LEFT = 1, I2S_STD_SLOT_RIGHT = 2, I2S_STD_SLOT_BOTH = 3 } i2s_std_slot_mask_t;
+
+typedef struct {
+  i2s_port_t id;
+  i2s_role_t role;
+  uint32_t dma_desc_num;
+  uint32_t dma_frame_num;
+  bool auto_clear;
+} i2s_chan_config_t;
+
+typedef struct {
+  uint32_t sample_rate_hz;
+} i2s_std_clk_config_t;
+
+typedef struct {
+  i2s_data_bit_width_t data_bit_width;
+  i2s_slot_mode_t slot_mode;
+  i2s_std_slot_mask_t slot_mask;
+} i2s_std_slot_config_t;
+
+typedef struct {
+  gpio_num_t mclk;
+  gpio_num_t bclk;
+  gpio_num_t ws;
+  gpio_num_t dout;
+  gpio_num_t din;
+  struct {
+    uint32_t mclk_inv : 1;
+    uint32_t bclk_inv : 1;
+    uint32_t ws_inv : 1;
+  } invert_flags;
+} i2s_std_gpio_config_t;
+
+typedef struct {
+  i2s_std_clk_config_t clk_cfg;
+  i2s_std_slot_config_t slot_cfg;
+  i2s_std_gpio_config_t gpio_cfg;
+} i2s_std_config_t;
+
+#define I2S_CHANNEL_DEFAULT_CONFIG(port, role) { (port), (role), 6, 240, false }
+#define I2S_STD_CLK_DEFAULT_CONFIG(rate) { (rate) }
+#define I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(bits, mode) { (bits), (mode), I2S_STD_SLOT_BOTH }
+
+inline esp_err_t i2s_new_channel(const i2s_chan_config_t*, i2s_chan_handle_t*, i2s_chan_handle_t*) {
+  return ESP_OK;
+}
+inline esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t, const i2s_std_config_t*) {
+  return ESP_OK;
+}
+inline esp_err_t i2s_channel_enable(i2s_chan_handle_t) { return ESP_OK; }
+inline esp_err_t i2s_channel_read(i2s_chan_handle_t, void*, size_t, size_t* bytesRead, uint32_t) {
+  *bytesRead = 0;
+  return ESP_ERR_TIMEOUT;
+}
+inline esp_err_t i2s_channel_write(i2s_chan_handle_t, const void*, size_t size, size_t* bytesWritten, uint32_t) {
+  *bytesWritten = size;
+  return ESP_OK;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Tasks are never started: the soak drives everything from one thread
+typedef void* TaskHandle_t;
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*)(void*), const char*, uint32_t,
+                                          void*, UBaseType_t, TaskHandle_t*, int) {
+  return pdPASS;
+}
+inline void vTaskDelay(TickType_t) {}
+inline void xTaskNotifyGive(TaskHandle_t) {}
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
@@ -0,0 +1,218 @@
+#include <unity.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ArduinoJson.h>
+#include <WebSocketsClient.h>
+#include <WiFi.h>
+
+#include "audio_codec.h"
+#include "control_message.h"
+#include "echo_canceller.h"
+#include "jitter_buffer.h"
+
+/*
+ * Thousands of sessions through main.cpp on the host, with this file
+ * playing the bridge: connect, ready, start_session / session_started,
+ * agent_speaking_start / _end, end_session / session_ended. Once the
+ * buffers from setup() exist a session must not touch the heap at all,
+ * so every allocation in the loop is a failure, and live bytes must be
+ * back where they started. Fragmentation on the board comes from exactly
+ * these per-session allocations; the high-water mark and glibc's free
+ * chunks are printed for comparison.
+ *
+ * Built only in [env:native_soak] (stubs/ stands in for Arduino/IDF).
+ * Counting replaces malloc and friends, so it needs glibc; elsewhere the
+ * tests are ignored.
+ */
+
+#define SOAK_SESSIONS 20000
+#define SAMPLE_RATE 16000          // as in main.cpp
+#define JITTER_MIN_MS 40
+#define JITTER_MAX_MS 300
+#define AEC_STEP_Q15 8192
+#define CONTROL_JSON_BYTES 512
+
+HardwareSerial Serial;
+EspClass ESP;
+WiFiClass WiFi;
+uint32_t stubMillis = 0;
+
+// main.cpp
+extern WebSocketsClient webSocket;
+extern JitterBuffer jitterBuffer;
+extern EchoCanceller echoCanceller;
+extern bool binaryControl;
+extern bool sessionStartPending;
+extern char currentSessionId[];
+void webSocketEvent(WStype_t type, uint8_t* payload, size_t length);
+void startNewSession();
+void endSession();
+
+/* ==================== HEAP COUNTING ==================== */
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static size_t heapAllocations = 0;
+static size_t heapLive = 0;
+static size_t heapHighWater = 0;
+
+static void heapAdd(void* ptr) {
+  if (!ptr) return;
+  heapLive += malloc_usable_size(ptr);
+  if (heapLive > heapHighWater) heapHighWater = heapLive;
+}
+
+static void heapRemove(void* ptr) {
+  if (ptr) heapLive -= malloc_usable_size(ptr);
+}
+
+extern "C" void* malloc(size_t size) {
+  void* ptr = __libc_malloc(size);
+  heapAllocations++;
+  heapAdd(ptr);
+  return ptr;
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  void* ptr = __libc_calloc(count, size);
+  heapAllocations++;
+  heapAdd(ptr);
+  return ptr;
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  heapRemove(ptr);
+  void* next = __libc_realloc(ptr, size);
+  heapAllocations++;
+  heapAdd(next ? next : ptr);
+  return next;
+}
+
+extern "C" void free(void* ptr) {
+  heapRemove(ptr);
+  __libc_free(ptr);
+}
+#endif
+
+/* ==================== BRIDGE SIDE ==================== */
+
+// In whichever form main.cpp negotiated, as Bridge.py would send it
+static void deliver(const ControlMessage& msg) {
+  if (binaryControl) {
+    uint8_t message[CONTROL_MAX_BYTES];
+    size_t length = msg.encode(message, sizeof(message));
+    webSocketEvent(WStype_BIN, message, length);
+    return;
+  }
+
+  StaticJsonDocument<CONTROL_JSON_BYTES> doc;
+  msg.toJson(doc);
+  char json[CONTROL_JSON_BYTES];
+  size_t length = serializeJson(doc, json, sizeof(json));
+  webSocketEvent(WStype_TEXT, (uint8_t*)json, length);
+}
+
+static void connect(bool binary) {
+  webSocketEvent(WStype_DISCONNECTED, nullptr, 0);
+  webSocketEvent(WStype_CONNECTED, nullptr, 0);
+
+  ControlMessage ready(CONTROL_READY);
+  ready.setUint(CTRL_CODEC, CODEC_ADPCM);
+  ready.setString(CTRL_CONTROL, binary ? "binary" : "json");
+  deliver(ready);  // still JSON: binaryControl is only set by this
+}
+
+static void runSession() {
+  stubMillis += 4000;  // a new session id each time
+  startNewSession();
+
+  ControlMessage started(CONTROL_SESSION_STARTED);
+  started.setString(CTRL_SESSION_ID, currentSessionId);
+  started.setUint(CTRL_DOWNLINK_CODEC, CODEC_ADPCM);
+  deliver(started);
+  TEST_ASSERT_FALSE_MESSAGE(sessionStartPending, "session_started not accepted");
+
+  ControlMessage speaking(CONTROL_AGENT_SPEAKING_START);
+  speaking.setUint(CTRL_SAMPLE_RATE, 24000);
+  deliver(speaking);
+  deliver(ControlMessage(CONTROL_AGENT_SPEAKING_END));
+
+  endSession();
+  deliver(ControlMessage(CONTROL_SESSION_ENDED));
+}
+
+static void soak(bool binary) {
+#ifndef __GLIBC__
+  TEST_IGNORE_MESSAGE("heap counting needs glibc");
+#else
+  connect(binary);
+  TEST_ASSERT_EQUAL(binary, binaryControl);
+  runSession();  // anything lazily set up on first use
+
+  uint32_t sent = binary ? webSocket.binarySent : webSocket.textSent;
+  size_t allocations = heapAllocations;
+  size_t live = heapLive;
+  heapHighWater = heapLive;
+
+  for (uint32_t i = 0; i < SOAK_SESSIONS; i++) {
+    runSession();
+  }
+
+  size_t perSession = heapAllocations - allocations;
+#if __GLIBC_PREREQ(2, 33)
+  struct mallinfo2 info = mallinfo2();
+#else
+  struct mallinfo info = mallinfo();
+#endif
+  printf("%s control: %u sessions, %u heap allocations, live %u -> %u bytes, "
+         "high water +%u bytes; glibc %u bytes free in %u chunks\n",
+         binary ? "binary" : "JSON", (unsigned)SOAK_SESSIONS, (unsigned)perSession,
+         (unsigned)live, (unsigned)heapLive, (unsigned)(heapHighWater - live),
+         (unsigned)info.fordblks, (unsigned)info.ordblks);
+
+  // start_session + end_session per session, nothing else on the control path
+  uint32_t sentNow = binary ? webSocket.binarySent : webSocket.textSent;
+  TEST_ASSERT_EQUAL_UINT32(2 * SOAK_SESSIONS, sentNow - sent);
+  TEST_ASSERT_EQUAL_MESSAGE(0, perSession, "heap allocation on the session path");
+  TEST_ASSERT_EQUAL_MESSAGE(live, heapLive, "live heap grew over the soak");
+#endif
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_soak_json_control() {
+  soak(false);
+}
+
+void test_soak_binary_control() {
+  soak(true);
+}
+
+static int runTests() {
+  // The buffers setup() allocates once at boot
+  jitterBuffer.begin(SAMPLE_RATE, JITTER_MIN_MS, JITTER_MAX_MS);
+  echoCanceller.begin(SAMPLE_RATE, AEC_STEP_Q15);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_soak_json_control);
+  RUN_TEST(test_soak_binary_control);
+  return UNITY_END();
+}
+
+int main() {
+  return runTests();
+}
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""
+Writes speech_in_noise.wav / .txt, the synthetic clip test_vad runs by
+default: 16 kHz mono int16 at the level the VAD sees (after MIC_GAIN).
+
+Speech is imitated, not recorded: voiced syllables (harmonics of a
+wandering pitch, two formant-like peaks, 4-6 Hz syllable envelope) with
+unvoiced fricative bursts between some of them, over room noise that
+also steps up halfway through. The .txt holds the talkspurts as
+"start end" seconds, one per line. Recordings go next to it the same way.
+"""
+
+import math
+import random
+import struct
+import wave
+
+RATE = 16000
+SECONDS = 8
+SEED = 3
+
+# (start, end) seconds of talk; gaps are noise only
+TALKSPURTS = [(0.80, 2.10), (2.60, 3.30), (4.40, 6.20), (6.90, 7.40)]
+
+def main():
+    rng = random.Random(SEED)
+    n = RATE * SECONDS
+    out = [0.0] * n
+
+    # Room noise: low-passed white noise, 6 dB louder in the second half
+    lp = 0.0
+    for i in range(n):
+        lp += 0.2 * (rng.gauss(0, 1) - lp)
+        level = 120 if i < n // 2 else 240
+        out[i] = level * lp * 2.5 + 20 * math.sin(2 * math.pi * 50 * i / RATE)
+
+    for start, end in TALKSPURTS:
+        phase = 0.0
+        f0 = rng.uniform(110, 200)
+        syllable_hz = rng.uniform(4, 6)
+        for i in range(int(start * RATE), int(end * RATE)):
+            t = i / RATE - start
+            f0 += rng.gauss(0, 0.3)
+            f0 = min(max(f0, 90), 240)
+            phase += 2 * math.pi * f0 / RATE
+            # Syllable envelope never quite closes inside a talkspurt
+            env = 0.25 + 0.75 * math.sin(math.pi * syllable_hz * t) ** 2
+            edge = min(1.0, t / 0.03, (end - i / RATE) / 0.03)
+            voiced = sum(math.sin(k * phase) * (1.0 if 400 < k * f0 < 900 or 1500 < k * f0 < 2500 else 0.25) / k
+                         for k in range(1, 20))
+            sample = 2600 * env * edge * voiced
+            # Fricative at every other syllable dip
+            if env < 0.35 and int(t * syllable_hz) % 2 == 1:
+                sample += 900 * edge * rng.gauss(0, 1)
+            out[i] += sample
+
+    with wave.open('speech_in_noise.wav', 'wb') as w:
+        w.setnchannels(1)
+        w.setsampwidth(2)
+        w.setframerate(RATE)
+        w.writeframes(b''.join(struct.pack('<h', max(-32768, min(32767, int(x)))) for x in out))
+    with open('speech_in_noise.txt', 'w') as f:
+        for start, end in TALKSPURTS:
+            f.write(f"{start:.2f} {end:.2f}\n")
+
+if __name__ == '__main__':
+    main()
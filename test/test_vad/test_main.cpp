@@ -0,0 +1,221 @@
+#include <unity.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vad.h"
+
+/*
+ * Runs labelled WAV clips through the VAD the way the capture task does
+ * (30 ms frames, VAD_LOOKBACK_FRAMES re-sent ahead of an onset) and
+ * reports uplink frames saved against talkspurt frames that were never
+ * sent. Clips are 16 kHz mono int16 at post-gain level; NAME.txt next to
+ * NAME.wav lists the talkspurts as "start end" seconds. The default clip
+ * is synthetic (make_clip.py); add recordings to CLIPS.
+ */
+
+#define CLIP_DIR "test/test_vad/"
+#define SAMPLE_RATE 16000
+#define FRAME_SAMPLES 480
+#define LOOKBACK_FRAMES 2          // VAD_LOOKBACK_FRAMES in main.cpp
+#define MAX_TALKSPURTS 64
+
+struct Clip {
+  const char* name;
+  float maxMissedPct;              // talkspurt frames never sent
+  float minSavedPct;               // frames not sent at all
+};
+
+static const Clip CLIPS[] = {
+  { "speech_in_noise", 2.0f, 20.0f },
+};
+
+struct Labels {
+  float start[MAX_TALKSPURTS];
+  float end[MAX_TALKSPURTS];
+  size_t count;
+};
+
+static FILE* openClipFile(const char* name, const char* extension) {
+  char path[128];
+  snprintf(path, sizeof(path), CLIP_DIR "%s%s", name, extension);
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    // Run from inside the test directory
+    snprintf(path, sizeof(path), "%s%s", name, extension);
+    f = fopen(path, "rb");
+  }
+  return f;
+}
+
+static uint32_t le32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 16 kHz mono PCM16 only; returns malloc'd samples or nullptr
+static int16_t* readWav(const char* name, size_t* samples) {
+  FILE* f = openClipFile(name, ".wav");
+  if (!f) return nullptr;
+
+  uint8_t riff[12];
+  bool formatOk = false;
+  int16_t* pcm = nullptr;
+  if (fread(riff, 1, 12, f) == 12 && memcmp(riff, "RIFF", 4) == 0 && memcmp(riff + 8, "WAVE", 4) == 0) {
+    uint8_t chunk[8];
+    while (fread(chunk, 1, 8, f) == 8) {
+      uint32_t size = le32(chunk + 4);
+      if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+        uint8_t fmt[16];
+        if (fread(fmt, 1, 16, f) != 16) break;
+        formatOk = (fmt[0] | (fmt[1] << 8)) == 1 && (fmt[2] | (fmt[3] << 8)) == 1 &&
+                   le32(fmt + 4) == SAMPLE_RATE && (fmt[14] | (fmt[15] << 8)) == 16;
+        fseek(f, size - 16 + (size & 1), SEEK_CUR);
+      } else if (memcmp(chunk, "data", 4) == 0 && formatOk) {
+        pcm = (int16_t*)malloc(size);
+        *samples = pcm ? fread(pcm, 2, size / 2, f) : 0;
+        break;
+      } else {
+        fseek(f, size + (size & 1), SEEK_CUR);
+      }
+    }
+  }
+  fclose(f);
+  return pcm;
+}
+
+static bool readLabels(const char* name, Labels& labels) {
+  FILE* f = openClipFile(name, ".txt");
+  if (!f) return false;
+  labels.count = 0;
+  while (labels.count < MAX_TALKSPURTS &&
+         fscanf(f, "%f %f", &labels.start[labels.count], &labels.end[labels.count]) == 2) {
+    labels.count++;
+  }
+  fclose(f);
+  return labels.count > 0;
+}
+
+// A frame is talk if its midpoint falls inside a talkspurt
+static bool isTalk(const Labels& labels, size_t frame) {
+  float t = (frame * FRAME_SAMPLES + FRAME_SAMPLES / 2) / (float)SAMPLE_RATE;
+  for (size_t i = 0; i < labels.count; i++) {
+    if (t >= labels.start[i] && t < labels.end[i]) return true;
+  }
+  return false;
+}
+
+static void runClip(const Clip& clip) {
+  size_t samples = 0;
+  int16_t* pcm = readWav(clip.name, &samples);
+  Labels labels;
+  TEST_ASSERT_NOT_NULL_MESSAGE(pcm, clip.name);
+  TEST_ASSERT_TRUE_MESSAGE(readLabels(clip.name, labels), clip.name);
+
+  size_t frames = samples / FRAME_SAMPLES;
+  bool* speech = (bool*)calloc(frames, sizeof(bool));
+  VadConfig config = VAD_DEFAULT_CONFIG;
+  Vad vad;
+  vad.begin(config);
+  for (size_t i = 0; i < frames; i++) {
+    speech[i] = vad.process(pcm + i * FRAME_SAMPLES, FRAME_SAMPLES);
+  }
+
+  // Sent: speech, or one of the silent frames replayed ahead of an onset
+  size_t sent = 0, talk = 0, missed = 0;
+  for (size_t i = 0; i < frames; i++) {
+    bool isSent = speech[i];
+    for (size_t k = 1; k <= LOOKBACK_FRAMES && !isSent && i + k < frames; k++) {
+      isSent = speech[i + k] && !speech[i + k - 1];
+    }
+    sent += isSent;
+    if (isTalk(labels, i)) {
+      talk++;
+      missed += !isSent;
+    }
+  }
+
+  float savedPct = 100.0f * (frames - sent) / frames;
+  float missedPct = talk ? 100.0f * missed / talk : 0;
+  char line[160];
+  snprintf(line, sizeof(line), "%s: %u frames, %u talk; sent %u, saved %.1f%% of uplink, missed %u talk frames (%.1f%%)",
+           clip.name, (unsigned)frames, (unsigned)talk, (unsigned)sent, savedPct, (unsigned)missed, missedPct);
+  TEST_MESSAGE(line);
+
+  free(speech);
+  free(pcm);
+  TEST_ASSERT_TRUE_MESSAGE(missedPct <= clip.maxMissedPct, clip.name);
+  TEST_ASSERT_TRUE_MESSAGE(savedPct >= clip.minSavedPct, clip.name);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_clips() {
+  for (const Clip& clip : CLIPS) runClip(clip);
+}
+
+void test_silence_is_suppressed() {
+  static int16_t silence[FRAME_SAMPLES];
+  VadConfig config = VAD_DEFAULT_CONFIG;
+  Vad vad;
+  vad.begin(config);
+  for (int i = 0; i < 100; i++) {
+    TEST_ASSERT_FALSE(vad.process(silence, FRAME_SAMPLES));
+  }
+}
+
+// Roughly Gaussian noise (sum of four uniforms) at the given RMS
+static void fillNoise(int16_t* samples, size_t count, float rms, uint32_t& seed) {
+  for (size_t i = 0; i < count; i++) {
+    int32_t sum = 0;
+    for (int k = 0; k < 4; k++) {
+      seed = seed * 1664525u + 1013904223u;
+      sum += (int32_t)(seed >> 16) - 32768;
+    }
+    samples[i] = (int16_t)(sum / 4 * rms / 9459.0f);  // uniform sum of 4 has RMS 32768/sqrt(12)
+  }
+}
+
+void test_noise_step_closes_gate() {
+  // A fan switching on for good: 5 s of room noise, then +10 dB. The jump
+  // reads as speech, but the gate must not stay open for the rest of the
+  // session.
+  const size_t framesPerSecond = SAMPLE_RATE / FRAME_SAMPLES;
+  const size_t stepFrame = 5 * framesPerSecond;
+  const size_t totalFrames = 30 * framesPerSecond;
+  static int16_t frame[FRAME_SAMPLES];
+  uint32_t seed = 1;
+  VadConfig config = VAD_DEFAULT_CONFIG;
+  Vad vad;
+  vad.begin(config);
+
+  size_t lastSpeech = 0;
+  for (size_t i = 0; i < totalFrames; i++) {
+    fillNoise(frame, FRAME_SAMPLES, i < stepFrame ? 100.0f : 316.0f, seed);
+    if (vad.process(frame, FRAME_SAMPLES)) lastSpeech = i;
+    if (i < stepFrame) TEST_ASSERT_EQUAL_UINT32(0, lastSpeech);
+  }
+
+  char line[96];
+  snprintf(line, sizeof(line), "+10 dB noise step: gate closed %.1f s after it",
+           (lastSpeech + 1 - stepFrame) / (float)framesPerSecond);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE_MESSAGE(lastSpeech > stepFrame, "the step should open the gate");
+  // floorResetFrames of hits, then the hangover
+  TEST_ASSERT_TRUE_MESSAGE(lastSpeech < stepFrame + config.floorResetFrames + config.hangoverFrames + 1,
+                           "gate stuck open after a permanent rise in noise");
+}
+
+static int runTests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_clips);
+  RUN_TEST(test_silence_is_suppressed);
+  RUN_TEST(test_noise_step_closes_gate);
+  return UNITY_END();
+}
+
+int main() {
+  return runTests();
+}